@@ -0,0 +1,125 @@
+#ifndef BLOCK_STORE_H
+#define BLOCK_STORE_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using BlockRef = uint32_t;
+constexpr BlockRef NIL_BLOCK = UINT32_MAX;
+
+// 48 bytes on a 64-bit host (3 size_t, int id, 4 links, free flag, padding).
+struct Block {
+    size_t start = 0;
+    size_t size = 0;
+    size_t requested = 0;
+    int id = -1;
+    BlockRef prev = NIL_BLOCK;  // address-order links, owned by BlockStore
+    BlockRef next = NIL_BLOCK;
+    BlockRef free_prev = NIL_BLOCK;  // TLSF free-list links, owned by the free index
+    BlockRef free_next = NIL_BLOCK;
+    bool free = true;
+
+    Block() = default;
+
+    Block(size_t s, size_t sz, bool f, int i, size_t req)
+        : start(s), size(sz), requested(req), id(i), free(f) {}
+
+    size_t internal_frag() const { return size > requested ? size - requested : 0; }
+};
+
+// Address-ordered doubly linked list of blocks kept in one contiguous array.
+// Links are indices, so handles survive growth; erased slots are recycled
+// through a free-slot chain before the array is extended.
+class BlockStore {
+public:
+    class const_iterator {
+    public:
+        const_iterator(const BlockStore *s, BlockRef r) : store(s), ref(r) {}
+        const Block &operator*() const { return store->nodes[ref]; }
+        const Block *operator->() const { return &store->nodes[ref]; }
+        const_iterator &operator++() { ref = store->nodes[ref].next; return *this; }
+        bool operator!=(const const_iterator &o) const { return ref != o.ref; }
+    private:
+        const BlockStore *store;
+        BlockRef ref;
+    };
+
+    Block &operator[](BlockRef r) { return nodes[r]; }
+    const Block &operator[](BlockRef r) const { return nodes[r]; }
+
+    BlockRef head() const { return first; }
+    BlockRef next(BlockRef r) const { return nodes[r].next; }
+    BlockRef prev(BlockRef r) const { return nodes[r].prev; }
+    size_t size() const { return live; }
+
+    const_iterator begin() const { return const_iterator(this, first); }
+    const_iterator end() const { return const_iterator(this, NIL_BLOCK); }
+
+    void clear() {
+        nodes.clear();  // keeps capacity for the next init
+        first = last = recycled = NIL_BLOCK;
+        live = 0;
+    }
+
+    BlockRef push_back(const Block &b) { return link_after(last, b); }
+    BlockRef insert_after(BlockRef pos, const Block &b) { return link_after(pos, b); }
+
+    void erase(BlockRef r) {
+        Block &b = nodes[r];
+        if (b.prev != NIL_BLOCK) nodes[b.prev].next = b.next; else first = b.next;
+        if (b.next != NIL_BLOCK) nodes[b.next].prev = b.prev; else last = b.prev;
+        b.next = recycled;
+        recycled = r;
+        live--;
+    }
+
+    // Snapshot support: the slot array and list ends exactly as they are, so
+    // an image restores the store (handles included) with one bulk copy.
+    struct Links {
+        BlockRef first, last, recycled;
+        uint32_t live;
+    };
+    const std::vector<Block> &slots() const { return nodes; }
+    Links links() const { return {first, last, recycled, (uint32_t)live}; }
+    void restore(const Block *slots, size_t n, const Links &l) {
+        nodes.assign(slots, slots + n);
+        first = l.first;
+        last = l.last;
+        recycled = l.recycled;
+        live = l.live;
+    }
+
+    // Number of times the backing array had to grow.
+    uint64_t allocations() const { return host_allocs; }
+
+private:
+    std::vector<Block> nodes;
+    BlockRef first = NIL_BLOCK;
+    BlockRef last = NIL_BLOCK;
+    BlockRef recycled = NIL_BLOCK;
+    size_t live = 0;
+    uint64_t host_allocs = 0;
+
+    BlockRef link_after(BlockRef pos, const Block &b) {
+        BlockRef r;
+        if (recycled != NIL_BLOCK) {
+            r = recycled;
+            recycled = nodes[r].next;
+            nodes[r] = b;
+        } else {
+            if (nodes.size() == nodes.capacity()) host_allocs++;
+            r = (BlockRef)nodes.size();
+            nodes.push_back(b);
+        }
+
+        Block &n = nodes[r];
+        n.prev = pos;
+        n.next = pos == NIL_BLOCK ? first : nodes[pos].next;
+        if (n.next != NIL_BLOCK) nodes[n.next].prev = r; else last = r;
+        if (pos != NIL_BLOCK) nodes[pos].next = r; else first = r;
+        live++;
+        return r;
+    }
+};
+
+#endif
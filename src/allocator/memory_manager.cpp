@@ -1,21 +1,110 @@
 #include "memory_manager.h"
+#include "../profile/profile.h"
+#include "../snapshot/snapshot.h"
+#include "../telemetry/frag_telemetry.h"
+#include <chrono>
+#include <cstring>
 #include <iterator>
 #include <iostream>
 #include <limits>
 #include<algorithm>
 #include<iomanip>
 
+const char *allocator_name(AllocatorType type) {
+    switch (type) {
+    case AllocatorType::FIRST_FIT: return "first_fit";
+    case AllocatorType::BEST_FIT: return "best_fit";
+    case AllocatorType::WORST_FIT: return "worst_fit";
+    case AllocatorType::NEXT_FIT: return "next_fit";
+    case AllocatorType::TLSF: return "tlsf";
+    }
+    return "?";
+}
+
+bool parse_allocator_type(const std::string &name, AllocatorType &out) {
+    if (name == "first_fit") out = AllocatorType::FIRST_FIT;
+    else if (name == "best_fit") out = AllocatorType::BEST_FIT;
+    else if (name == "worst_fit") out = AllocatorType::WORST_FIT;
+    else if (name == "next_fit") out = AllocatorType::NEXT_FIT;
+    else if (name == "tlsf") out = AllocatorType::TLSF;
+    else return false;
+    return true;
+}
+
+const char *compaction_name(CompactionMode mode) {
+    switch (mode) {
+    case CompactionMode::OFF: return "off";
+    case CompactionMode::FULL: return "full";
+    case CompactionMode::INCREMENTAL: return "incremental";
+    }
+    return "?";
+}
+
+bool parse_compaction_mode(const std::string &name, CompactionMode &out) {
+    if (name == "off") out = CompactionMode::OFF;
+    else if (name == "full") out = CompactionMode::FULL;
+    else if (name == "incremental") out = CompactionMode::INCREMENTAL;
+    else return false;
+    return true;
+}
+
+namespace {
+
+// Scalar state of a heap image; the arrays go in their own sections.
+struct HeapImage {
+    uint64_t memory_size;
+    uint64_t used_mem;
+    uint64_t internal_frag;
+    uint64_t alloc_success;
+    uint64_t alloc_fail;
+    uint64_t next_id;
+    uint64_t time;
+    int64_t total_requests;
+    uint32_t allocator;
+    uint32_t compaction;
+    uint32_t compact_threshold;
+    uint32_t compacting;
+    uint64_t compact_budget;
+    uint64_t compact_credit;
+    uint64_t compact_goal;
+    CompactionStats compaction_totals;
+    BlockStore::Links links;
+    BlockRef rover;
+};
+
+}  // namespace
+
 MemoryManagerSimulator::MemoryManagerSimulator()
-   : allocator(AllocatorType::FIRST_FIT), memory_size(0), alloc_success(0), alloc_fail(0), internal_frag(0), time(0), next_id(1) {}
+   : allocator(AllocatorType::FIRST_FIT), memory_size(0), alloc_success(0), alloc_fail(0), internal_frag(0), time(0), next_id(1),
+     free_bins(NUM_BINS, FreeBin(FreeBin::allocator_type(&index_arena))),
+     free_by_size(SizeIndex::allocator_type(&index_arena)) {
+    for (auto &row : tlsf_heads)
+        for (BlockRef &h : row) h = NIL_BLOCK;
+}
 
 void MemoryManagerSimulator::init(size_t total_size) {
     memory_size = total_size;
     alloc_success = 0;
     alloc_fail = 0;
     internal_frag = 0;
+    used_mem = 0;
     time = 0;
     next_id = 1;
     blocks.clear();
+    id_table.assign(1, NIL_BLOCK);
+    for (auto &bin : free_bins) bin.clear();
+    bin_mask = 0;
+    free_by_size.clear();
+    empty_free = 0;
+    compact_credit = 0;
+    compacting = false;
+    compact_goal = 0;
+    compaction_totals = CompactionStats();
+    tlsf_fl_mask = 0;
+    for (size_t fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        tlsf_sl_mask[fl] = 0;
+        for (BlockRef &h : tlsf_heads[fl]) h = NIL_BLOCK;
+    }
 
     Block b;
     b.start = 0;
@@ -23,9 +112,9 @@ void MemoryManagerSimulator::init(size_t total_size) {
     b.free = true;
     b.id = -1;
     b.requested = 0;
-    b.internal_frag = 0;
 
-    blocks.push_back(b);
+    rover = blocks.push_back(b);
+    index_insert(rover);
 }
 
 
@@ -33,100 +122,568 @@ void MemoryManagerSimulator::setAllocator(AllocatorType type) {
     allocator = type;
 }
 
-std::list<Block>::iterator MemoryManagerSimulator::find_first_fit(size_t size) {
-    for (auto it = blocks.begin(); it != blocks.end(); ++it)
-        if (it->free && it->size >= size)
-            return it;
-    return blocks.end();
+void MemoryManagerSimulator::setCompaction(CompactionMode mode, unsigned threshold_pct, size_t budget) {
+    compaction = mode;
+    compact_threshold = threshold_pct;
+    compact_budget = budget ? budget : 1;
+    compact_credit = 0;
+    compacting = false;
+    compact_goal = 0;
 }
 
-std::list<Block>::iterator MemoryManagerSimulator::find_best_fit(size_t size) {
-    auto best = blocks.end();
-    size_t smallest = std::numeric_limits<size_t>::max();
-    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-        if (it->free && it->size >= size && it->size < smallest) {
-            smallest = it->size;
-            best = it;
+size_t MemoryManagerSimulator::size_class(size_t size) {
+    return size ? 63 - __builtin_clzll(size) : 0;
+}
+
+void MemoryManagerSimulator::tlsf_mapping(size_t size, size_t &fl, size_t &sl) {
+    if (size < TLSF_SL_COUNT) {
+        fl = 0;
+        sl = size;
+        return;
+    }
+    size_t log = size_class(size);
+    fl = log - TLSF_SL_BITS + 1;
+    sl = (size >> (log - TLSF_SL_BITS)) & (TLSF_SL_COUNT - 1);
+}
+
+void MemoryManagerSimulator::index_insert(BlockRef r) {
+    Block &b = blocks[r];
+    if (b.size == 0) {
+        empty_free++;
+        return;
+    }
+    size_t c = size_class(b.size);
+    free_bins[c].emplace(b.start, r);
+    bin_mask |= 1ULL << c;
+    free_by_size.emplace(std::make_pair(b.size, b.start), r);
+
+    size_t fl, sl;
+    tlsf_mapping(b.size, fl, sl);
+    BlockRef &head = tlsf_heads[fl][sl];
+    b.free_prev = NIL_BLOCK;
+    b.free_next = head;
+    if (head != NIL_BLOCK) blocks[head].free_prev = r;
+    head = r;
+    tlsf_sl_mask[fl] |= 1u << sl;
+    tlsf_fl_mask |= 1ULL << fl;
+}
+
+void MemoryManagerSimulator::index_erase(BlockRef r) {
+    const Block &b = blocks[r];
+    if (b.size == 0) {
+        empty_free--;
+        return;
+    }
+    size_t c = size_class(b.size);
+    free_bins[c].erase(b.start);
+    if (free_bins[c].empty()) bin_mask &= ~(1ULL << c);
+    free_by_size.erase(std::make_pair(b.size, b.start));
+
+    size_t fl, sl;
+    tlsf_mapping(b.size, fl, sl);
+    if (b.free_prev != NIL_BLOCK) blocks[b.free_prev].free_next = b.free_next;
+    else tlsf_heads[fl][sl] = b.free_next;
+    if (b.free_next != NIL_BLOCK) blocks[b.free_next].free_prev = b.free_prev;
+    if (tlsf_heads[fl][sl] == NIL_BLOCK) {
+        tlsf_sl_mask[fl] &= ~(1u << sl);
+        if (!tlsf_sl_mask[fl]) tlsf_fl_mask &= ~(1ULL << fl);
+    }
+}
+
+BlockRef MemoryManagerSimulator::find_first_fit(size_t size, size_t from) {
+    // Every block in a bin above size_class(size) fits, so the lowest
+    // address (at or after `from`) among them bounds the scan of the
+    // request's own bin.
+    size_t c = size_class(size);
+    BlockRef found = NIL_BLOCK;
+    size_t lowest = std::numeric_limits<size_t>::max();
+    MEMSIM_PROFILE_ONLY(uint64_t scanned = 0;)
+
+    uint64_t higher = c + 1 < NUM_BINS ? bin_mask & (~0ULL << (c + 1)) : 0;
+    while (higher) {
+        size_t b = __builtin_ctzll(higher);
+        higher &= higher - 1;
+        MEMSIM_PROFILE_ONLY(scanned++;)
+        auto head = from ? free_bins[b].lower_bound(from) : free_bins[b].begin();
+        if (head != free_bins[b].end() && head->first < lowest) {
+            lowest = head->first;
+            found = head->second;
         }
     }
-    return best;
+
+    auto it = from ? free_bins[c].lower_bound(from) : free_bins[c].begin();
+    for (; it != free_bins[c].end(); ++it) {
+        if (it->first >= lowest) break;
+        MEMSIM_PROFILE_ONLY(scanned++;)
+        if (blocks[it->second].size >= size) {
+            MEMSIM_PROFILE_COUNT(ProfCounter::FIT_SCAN, scanned);
+            return it->second;
+        }
+    }
+    MEMSIM_PROFILE_COUNT(ProfCounter::FIT_SCAN, scanned);
+    return found;
+}
+
+BlockRef MemoryManagerSimulator::find_next_fit(size_t size) {
+    size_t from = rover != NIL_BLOCK ? blocks[rover].start : 0;
+    BlockRef r = find_first_fit(size, from);
+    if (r == NIL_BLOCK && from) r = find_first_fit(size);   // wrap around
+    return r;
 }
 
-std::list<Block>::iterator MemoryManagerSimulator::find_worst_fit(size_t size) {
-    auto worst = blocks.end();
-    size_t largest = 0;
-    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-        if (it->free && it->size >= size && it->size > largest) {
-            largest = it->size;
-            worst = it;
+BlockRef MemoryManagerSimulator::find_tlsf(size_t size) {
+    // Round the request up to the next second-level boundary so any block
+    // in the list found is large enough; the search is then two bit scans.
+    size_t search = size;
+    if (size >= TLSF_SL_COUNT) {
+        size_t round = ((size_t)1 << (size_class(size) - TLSF_SL_BITS)) - 1;
+        search = size + round < size ? size : size + round;
+    }
+    size_t fl, sl;
+    tlsf_mapping(search, fl, sl);
+
+    uint32_t sl_map = tlsf_sl_mask[fl] & (~0u << sl);
+    if (!sl_map) {
+        uint64_t fl_map = fl + 1 < TLSF_FL_COUNT ? tlsf_fl_mask & (~0ULL << (fl + 1)) : 0;
+        if (fl_map) {
+            fl = __builtin_ctzll(fl_map);
+            sl_map = tlsf_sl_mask[fl];
         }
     }
-    return worst;
+    if (sl_map) {
+        MEMSIM_PROFILE_COUNT(ProfCounter::FIT_SCAN, 1);
+        return tlsf_heads[fl][__builtin_ctz(sl_map)];
+    }
+
+    // Only the request's own range can still hold a fit; walk it rather
+    // than fail where the other strategies would succeed.
+    tlsf_mapping(size, fl, sl);
+    MEMSIM_PROFILE_ONLY(uint64_t scanned = 0;)
+    for (BlockRef r = tlsf_heads[fl][sl]; r != NIL_BLOCK; r = blocks[r].free_next) {
+        MEMSIM_PROFILE_ONLY(scanned++;)
+        if (blocks[r].size >= size) {
+            MEMSIM_PROFILE_COUNT(ProfCounter::FIT_SCAN, scanned);
+            return r;
+        }
+    }
+    MEMSIM_PROFILE_COUNT(ProfCounter::FIT_SCAN, scanned);
+    return NIL_BLOCK;
+}
+
+BlockRef MemoryManagerSimulator::find_best_fit(size_t size) {
+    MEMSIM_PROFILE_COUNT(ProfCounter::FIT_SCAN, 1);   // one ordered-map lookup
+    auto it = free_by_size.lower_bound(std::make_pair(size, (size_t)0));
+    return it == free_by_size.end() ? NIL_BLOCK : it->second;
+}
+
+BlockRef MemoryManagerSimulator::find_worst_fit(size_t size) {
+    MEMSIM_PROFILE_COUNT(ProfCounter::FIT_SCAN, 1);
+    if (free_by_size.empty()) return NIL_BLOCK;
+    size_t largest = free_by_size.rbegin()->first.first;
+    if (largest == 0 || largest < size) return NIL_BLOCK;
+    // Ties go to the lowest address, as in an address-ordered scan.
+    return free_by_size.lower_bound(std::make_pair(largest, (size_t)0))->second;
+}
+
+// First fit takes the first free block in list order, best fit the first
+// empty one; worst fit never picks an empty block.
+BlockRef MemoryManagerSimulator::find_empty_fit() const {
+    for (BlockRef r = blocks.head(); r != NIL_BLOCK; r = blocks.next(r))
+        if (blocks[r].free && (blocks[r].size == 0 || allocator == AllocatorType::FIRST_FIT)) return r;
+    return NIL_BLOCK;
+}
+
+BlockRef MemoryManagerSimulator::find_fit(size_t size) {
+    if (size == 0 && empty_free && (allocator == AllocatorType::FIRST_FIT || allocator == AllocatorType::BEST_FIT))
+        return find_empty_fit();
+    switch (allocator) {
+    case AllocatorType::FIRST_FIT: return find_first_fit(size);
+    case AllocatorType::BEST_FIT: return find_best_fit(size);
+    case AllocatorType::WORST_FIT: return find_worst_fit(size);
+    case AllocatorType::NEXT_FIT: return find_next_fit(size);
+    case AllocatorType::TLSF: return find_tlsf(size);
+    }
+    return NIL_BLOCK;
 }
 
 int MemoryManagerSimulator::malloc_block(size_t size) {
+    MEMSIM_PROFILE_SCOPE(ProfOp::MALLOC);
     const size_t ALIGN = 16;
+    // A size within ALIGN of SIZE_MAX would round up to a tiny block.
+    bool fits = size <= SIZE_MAX - (ALIGN - 1);
     size_t actual = (size + ALIGN - 1) & ~(ALIGN - 1);
 
-    auto it = blocks.end();
-    if (allocator == AllocatorType::FIRST_FIT)
-        it = find_first_fit(actual);
-    else if (allocator == AllocatorType::BEST_FIT)
-        it = find_best_fit(actual);
-    else if (allocator == AllocatorType::WORST_FIT)
-        it = find_worst_fit(actual);
+    BlockRef r = fits ? find_fit(actual) : NIL_BLOCK;
+    if (r == NIL_BLOCK && fits && compaction != CompactionMode::OFF && memory_size - used_mem >= actual) {
+        // Enough bytes are free, just not in one piece.
+        compacting = true;
+        compact_goal = std::max(compact_goal, actual);
+        if (compaction == CompactionMode::FULL) compact();
+        else compact_slice(compact_budget);
+        r = find_fit(actual);
+        if (r != NIL_BLOCK) compaction_totals.rescued++;
+    }
 
-    if (it == blocks.end()) {
+    if (r == NIL_BLOCK) {
         alloc_fail++;
+        if (telemetry) telemetry->tick(*this);
         return -1;
     }
 
     alloc_success++;
     int id = next_id++;  
+    index_erase(r);
 
-    if (it->size > actual) {
+    if (blocks[r].size > actual) {
         Block rem;
-        rem.start = it->start + actual;
-        rem.size = it->size - actual;
+        rem.start = blocks[r].start + actual;
+        rem.size = blocks[r].size - actual;
         rem.free = true;
         rem.id = -1;
-        blocks.insert(std::next(it), rem);
+        index_insert(blocks.insert_after(r, rem));
     }
 
-    it->size = actual;
-    it->free = false;
-    it->id = id;
-    it->requested = size;
-    it->internal_frag = actual - size;
+    Block &b = blocks[r];
+    b.size = actual;
+    b.free = false;
+    b.id = id;
+    b.requested = size;
     internal_frag += (actual - size);
+    used_mem += actual;
+    rover = blocks.next(r);
+
+    if (id_table.size() == id_table.capacity()) id_table_allocs++;
+    id_table.push_back(r);
 
+    if (compaction != CompactionMode::OFF) after_op();
+    if (telemetry) telemetry->tick(*this);
     return id;
 }
 
 
 bool MemoryManagerSimulator::free_block(int block_id) {
-    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-        if (!it->free && it->id == block_id) {
-            it->free = true;
-            it->id = -1;
-
-            auto nx = std::next(it);
-            if (nx != blocks.end() && nx->free) {
-                it->size += nx->size;
-                blocks.erase(nx);
-            }
+    MEMSIM_PROFILE_SCOPE(ProfOp::FREE);
+    if (block_id <= 0 || (uint64_t)block_id >= next_id) return false;
+    BlockRef r = id_table[block_id];
+    if (r == NIL_BLOCK) return false;
+
+    id_table[block_id] = NIL_BLOCK;
+    Block &b = blocks[r];
+    b.free = true;
+    b.id = -1;
+    b.requested = 0;
+    used_mem -= b.size;
+    coalesce(r);
+    if (compaction != CompactionMode::OFF) after_op();
+    if (telemetry) telemetry->tick(*this);
+    return true;
+}
+
+bool MemoryManagerSimulator::block_extent(int block_id, size_t &start, size_t &size) const {
+    if (block_id <= 0 || (uint64_t)block_id >= next_id) return false;
+    BlockRef r = id_table[block_id];
+    if (r == NIL_BLOCK) return false;
+    start = blocks[r].start;
+    size = blocks[r].size;
+    return true;
+}
+
+bool MemoryManagerSimulator::block_address(int block_id, size_t &start) const {
+    size_t size;
+    return block_extent(block_id, start, size);
+}
+
+// Lowest-addressed free block: the heads of the non-empty first-fit bins.
+BlockRef MemoryManagerSimulator::lowest_free() const {
+    BlockRef found = NIL_BLOCK;
+    size_t lowest = std::numeric_limits<size_t>::max();
+    for (uint64_t m = bin_mask; m; m &= m - 1) {
+        const FreeBin &bin = free_bins[__builtin_ctzll(m)];
+        if (bin.begin()->first < lowest) {
+            lowest = bin.begin()->first;
+            found = bin.begin()->second;
+        }
+    }
+    return found;
+}
 
-            if (it != blocks.begin()) {
-                auto pv = std::prev(it);
-                if (pv->free) {
-                    pv->size += it->size;
-                    blocks.erase(it);
-                }
+// Starts a compaction cycle once fragmentation crosses the threshold and
+// advances a running one.
+void MemoryManagerSimulator::after_op() {
+    if (!compacting && compact_threshold) {
+        MemoryStats st = snapshot();
+        compacting = st.free_blocks > 1 && st.external_frag() >= compact_threshold;
+    }
+    if (!compacting) return;
+    if (compaction == CompactionMode::FULL) compact();
+    else compact_slice(compact_budget);
+}
+
+void MemoryManagerSimulator::compact() {
+    auto t0 = std::chrono::steady_clock::now();
+    size_t cursor = 0;
+    for (BlockRef r = blocks.head(); r != NIL_BLOCK;) {
+        BlockRef nx = blocks.next(r);
+        Block &b = blocks[r];
+        if (b.free) {
+            index_erase(r);
+            blocks.erase(r);
+        } else {
+            if (b.start != cursor) {
+                b.start = cursor;
+                compaction_totals.blocks_moved++;
+                compaction_totals.bytes_moved += b.size;
             }
-            return true;
+            cursor += b.size;
+        }
+        r = nx;
+    }
+
+    rover = NIL_BLOCK;
+    if (cursor < memory_size) {
+        rover = blocks.push_back(Block(cursor, memory_size - cursor, true, -1, 0));
+        index_insert(rover);
+    }
+    compaction_totals.full_runs++;
+    compaction_totals.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    compacting = false;
+    compact_credit = 0;
+    compact_goal = 0;
+}
+
+bool MemoryManagerSimulator::compaction_done() const {
+    MemoryStats st = snapshot();
+    return st.largest_free >= compact_goal && (!compact_threshold || st.external_frag() < compact_threshold);
+}
+
+// Slides the live block above the lowest hole down into it, repeatedly,
+// while the budget lasts. The hole's node takes over the live block (so
+// its id now maps there) and the live block's node becomes the hole, which
+// then merges with whatever free space follows.
+void MemoryManagerSimulator::compact_slice(size_t budget) {
+    auto t0 = std::chrono::steady_clock::now();
+    compact_credit += budget;
+    bool moved = false;
+    while (true) {
+        BlockRef hole = lowest_free();
+        BlockRef live = hole == NIL_BLOCK ? NIL_BLOCK : blocks.next(hole);
+        // Stop once the cycle's goal is met or the free space is a single tail block.
+        if (live == NIL_BLOCK || compaction_done()) {
+            compacting = false;
+            compact_credit = 0;
+            compact_goal = 0;
+            break;
         }
+        Block &h = blocks[hole];
+        Block &l = blocks[live];
+        if (l.size > compact_credit) break;
+
+        index_erase(hole);
+        size_t hole_start = h.start, hole_size = h.size;
+        h.size = l.size;
+        h.requested = l.requested;
+        h.id = l.id;
+        h.free = false;
+        id_table[l.id] = hole;
+
+        l.start = hole_start + h.size;
+        l.size = hole_size;
+        l.requested = 0;
+        l.id = -1;
+        l.free = true;
+        coalesce(live);
+
+        compact_credit -= h.size;
+        compaction_totals.blocks_moved++;
+        compaction_totals.bytes_moved += h.size;
+        moved = true;
     }
-    return false;
+    if (moved) compaction_totals.steps++;
+    compaction_totals.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void MemoryManagerSimulator::coalesce(BlockRef r) {
+    // Only the physical neighbours are inspected; a free neighbour leaves the
+    // index before it is absorbed, and the merged block is indexed once.
+    BlockRef nx = blocks.next(r);
+    if (nx != NIL_BLOCK && blocks[nx].free) {
+        index_erase(nx);
+        blocks[r].size += blocks[nx].size;
+        blocks.erase(nx);
+        if (rover == nx) rover = r;
+    }
+
+    BlockRef pv = blocks.prev(r);
+    if (pv != NIL_BLOCK && blocks[pv].free) {
+        index_erase(pv);
+        blocks[pv].size += blocks[r].size;
+        blocks.erase(r);
+        if (rover == r) rover = pv;
+        r = pv;
+    }
+    index_insert(r);
+}
+
+void MemoryManagerSimulator::save_image(ImageWriter &img) const {
+    HeapImage h{};
+    h.memory_size = memory_size;
+    h.used_mem = used_mem;
+    h.internal_frag = internal_frag;
+    h.alloc_success = alloc_success;
+    h.alloc_fail = alloc_fail;
+    h.next_id = next_id;
+    h.time = time;
+    h.total_requests = total_requests;
+    h.allocator = (uint32_t)allocator;
+    h.compaction = (uint32_t)compaction;
+    h.compact_threshold = compact_threshold;
+    h.compacting = compacting;
+    h.compact_budget = compact_budget;
+    h.compact_credit = compact_credit;
+    h.compact_goal = compact_goal;
+    h.compaction_totals = compaction_totals;
+    h.links = blocks.links();
+    h.rover = rover;
+    img.addValue("mm.state", h);
+    img.add("mm.blocks", blocks.slots());
+    img.add("mm.ids", id_table);
+    img.add("mm.tlsf", &tlsf_heads[0][0], sizeof(tlsf_heads));
+}
+
+bool MemoryManagerSimulator::load_image(const ImageFile &img, std::string &err) {
+    HeapImage h;
+    size_t n = 0, ids = 0;
+    const Block *slots = img.view<Block>("mm.blocks", n);
+    const BlockRef *id_view = img.view<BlockRef>("mm.ids", ids);
+    BlockRef heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    if (!img.readValue("mm.state", h) || !slots || !id_view ||
+        !img.readExact("mm.tlsf", &heads[0][0], TLSF_FL_COUNT * TLSF_SL_COUNT)) {
+        err = "image has no heap";
+        return false;
+    }
+
+    // Every handle that later operations follow is checked here: the list
+    // must run first -> last through contiguous blocks covering the heap,
+    // recycled slots must chain outside it, the id table must name exactly
+    // the used blocks, and the TLSF lists exactly the free ones.
+    auto in_range = [&](BlockRef r) { return r == NIL_BLOCK || r < n; };
+    bool ok = n < NIL_BLOCK && in_range(h.links.first) && in_range(h.links.last) && in_range(h.links.recycled) &&
+              in_range(h.rover) && h.links.live <= n && (ids == h.next_id || (!ids && h.links.first == NIL_BLOCK)) &&
+              h.next_id <= (uint64_t)std::numeric_limits<int>::max() &&
+              h.allocator <= (uint32_t)AllocatorType::TLSF && h.compaction <= (uint32_t)CompactionMode::INCREMENTAL &&
+              h.compact_budget;
+    enum : uint8_t { UNSEEN, LISTED, RECYCLED, LINKED };
+    std::vector<uint8_t> seen(ok ? n : 0, UNSEEN);
+    auto flag_ok = [&](BlockRef r) {
+        uint8_t raw;
+        std::memcpy(&raw, &slots[r].free, 1);
+        return raw <= 1;
+    };
+    size_t walked = 0, end = 0, used = 0, used_blocks = 0, free_blocks = 0, empty_blocks = 0;
+    BlockRef prev = NIL_BLOCK;
+    for (BlockRef r = h.links.first; ok && r != NIL_BLOCK; r = slots[r].next) {
+        ok = r < n && seen[r] == UNSEEN && flag_ok(r) && slots[r].prev == prev && slots[r].start == end &&
+             slots[r].size <= h.memory_size - end;
+        if (!ok) break;
+        seen[r] = LISTED;
+        walked++;
+        end += slots[r].size;
+        if (slots[r].free) {
+            if (slots[r].size) free_blocks++;
+            else empty_blocks++;
+        } else {
+            used_blocks++;
+            used += slots[r].size;
+        }
+        prev = r;
+    }
+    ok = ok && prev == h.links.last && walked == h.links.live && end == h.memory_size && used == h.used_mem &&
+         (h.rover == NIL_BLOCK || seen[h.rover] == LISTED);
+    size_t recycled = 0;
+    for (BlockRef r = h.links.recycled; ok && r != NIL_BLOCK; r = slots[r].next) {
+        ok = r < n && seen[r] == UNSEEN;
+        if (!ok) break;
+        seen[r] = RECYCLED;
+        recycled++;
+    }
+    ok = ok && recycled == n - walked && (!ids || id_view[0] == NIL_BLOCK);
+    size_t named = 0;
+    for (size_t i = 1; ok && i < ids; i++) {
+        BlockRef r = id_view[i];
+        if (r == NIL_BLOCK) continue;
+        ok = r < n && seen[r] == LISTED && !slots[r].free && slots[r].id == (int)i;
+        named++;
+    }
+    ok = ok && named == used_blocks;
+    size_t linked = 0;
+    for (size_t i = 0; ok && i < TLSF_FL_COUNT * TLSF_SL_COUNT; i++) {
+        BlockRef before = NIL_BLOCK;
+        for (BlockRef r = heads[i / TLSF_SL_COUNT][i % TLSF_SL_COUNT]; ok && r != NIL_BLOCK; r = slots[r].free_next) {
+            size_t fl, sl;
+            ok = r < n && seen[r] == LISTED && slots[r].free && slots[r].size && slots[r].free_prev == before;
+            if (!ok) break;
+            tlsf_mapping(slots[r].size, fl, sl);
+            ok = fl * TLSF_SL_COUNT + sl == i;
+            seen[r] = LINKED;
+            linked++;
+            before = r;
+        }
+    }
+    ok = ok && linked == free_blocks;
+    if (!ok) {
+        err = "heap image is inconsistent";
+        return false;
+    }
+
+    memory_size = h.memory_size;
+    used_mem = h.used_mem;
+    internal_frag = h.internal_frag;
+    alloc_success = h.alloc_success;
+    alloc_fail = h.alloc_fail;
+    next_id = h.next_id;
+    time = h.time;
+    total_requests = (int)h.total_requests;
+    allocator = (AllocatorType)h.allocator;
+    compaction = (CompactionMode)h.compaction;
+    compact_threshold = h.compact_threshold;
+    compacting = h.compacting != 0;
+    compact_budget = h.compact_budget;
+    compact_credit = h.compact_credit;
+    compact_goal = h.compact_goal;
+    compaction_totals = h.compaction_totals;
+    rover = h.rover;
+    blocks.restore(slots, n, h.links);
+    id_table.assign(id_view, id_view + ids);
+
+    // TLSF lists are threaded through the restored slots, so only their
+    // heads and bitmaps come back; the ordered maps are node-based and are
+    // rebuilt, which gives the same iteration order they had.
+    tlsf_fl_mask = 0;
+    for (size_t fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        tlsf_sl_mask[fl] = 0;
+        for (size_t sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            tlsf_heads[fl][sl] = heads[fl][sl];
+            if (heads[fl][sl] != NIL_BLOCK) tlsf_sl_mask[fl] |= 1u << sl;
+        }
+        if (tlsf_sl_mask[fl]) tlsf_fl_mask |= 1ULL << fl;
+    }
+    for (auto &bin : free_bins) bin.clear();
+    bin_mask = 0;
+    free_by_size.clear();
+    empty_free = empty_blocks;
+    for (BlockRef r = blocks.head(); r != NIL_BLOCK; r = blocks.next(r)) {
+        const Block &b = blocks[r];
+        if (!b.free || !b.size) continue;
+        size_t cls = size_class(b.size);
+        free_bins[cls].emplace(b.start, r);
+        bin_mask |= 1ULL << cls;
+        free_by_size.emplace(std::make_pair(b.size, b.start), r);
+    }
+    return true;
+}
+
+uint64_t MemoryManagerSimulator::host_allocations() const {
+    return blocks.allocations() + index_arena.allocations() + id_table_allocs;
 }
 
 void MemoryManagerSimulator::dump() const {
@@ -140,36 +697,49 @@ void MemoryManagerSimulator::dump() const {
     }
     std::cout << std::dec;
 }
-void MemoryManagerSimulator::stats() const {
-    size_t used = 0;
-    size_t largest_free = 0;
-    size_t free_mem = 0;
+MemoryStats MemoryManagerSimulator::snapshot() const {
+    MemoryStats st;
+    st.total = memory_size;
+    st.used = used_mem;
+    st.free = memory_size - used_mem;
+    st.largest_free = free_by_size.empty() ? 0 : free_by_size.rbegin()->first.first;
+    st.free_blocks = free_by_size.size();
+    st.internal_frag = internal_frag;
+    st.alloc_success = alloc_success;
+    st.alloc_fail = alloc_fail;
+    return st;
+}
 
-    for (const auto &b : blocks) {
-        if (b.free) {
-            free_mem += b.size;
-            largest_free = std::max(largest_free, b.size);
-        } else {
-            used += b.size;
-        }
-    }
+void MemoryManagerSimulator::free_histogram(uint32_t *out, size_t bins) const {
+    // The first-fit bins already group free blocks by floor(log2(size)).
+    for (size_t b = 0; b < bins; b++) out[b] = 0;
+    for (size_t b = 0; b < NUM_BINS; b++)
+        out[b < bins ? b : bins - 1] += (uint32_t)free_bins[b].size();
+}
 
-    double utilization = memory_size ? ((double)used / memory_size) * 100.0 : 0.0;
-    double ext_frag = free_mem ? (1.0 - (double)largest_free / free_mem) * 100.0 : 0.0;
-    int total_requests = alloc_success + alloc_fail;
-    double success_rate = total_requests ? ((double)alloc_success / total_requests) * 100.0 : 0.0;
-    double failure_rate = 100.0 - success_rate;
+void MemoryManagerSimulator::stats() const {
+    MemoryStats st = snapshot();
 
     std::cout << "\n=== MEMORY STATS ===\n";
-    std::cout << "Total memory: " << memory_size << " bytes\n";
-    std::cout << "Used memory: " << used << " bytes\n";
-    std::cout << "Free memory: " << (memory_size - used) << " bytes\n";
-    std::cout << "Memory utilization: " << std::fixed << std::setprecision(2) << utilization << "%\n";
-    std::cout << "Internal fragmentation: " << internal_frag << " bytes\n";
-    std::cout << "External fragmentation: " << std::fixed << std::setprecision(2) << ext_frag << "%\n";
-    std::cout << "Allocation success rate: " << std::fixed << std::setprecision(2) << success_rate << "%\n";
-    std::cout << "Allocation failure rate: " << std::fixed << std::setprecision(2) << failure_rate << "%\n";
-    std::cout << "Total allocation requests: " << total_requests << "\n";
+    std::cout << "Total memory: " << st.total << " bytes\n";
+    std::cout << "Used memory: " << st.used << " bytes\n";
+    std::cout << "Free memory: " << st.free << " bytes\n";
+    std::cout << "Memory utilization: " << std::fixed << std::setprecision(2) << st.utilization() << "%\n";
+    std::cout << "Internal fragmentation: " << st.internal_frag << " bytes\n";
+    std::cout << "External fragmentation: " << std::fixed << std::setprecision(2) << st.external_frag() << "%\n";
+    std::cout << "Allocation success rate: " << std::fixed << std::setprecision(2) << st.success_rate() << "%\n";
+    std::cout << "Allocation failure rate: " << std::fixed << std::setprecision(2) << 100.0 - st.success_rate() << "%\n";
+    std::cout << "Total allocation requests: " << st.requests() << "\n";
+    std::cout << "Simulator host allocations: " << host_allocations() << "\n";
+    const CompactionStats &cs = compaction_totals;
+    if (compaction != CompactionMode::OFF || cs.full_runs || cs.steps) {
+        std::cout << "Compaction (" << compaction_name(compaction) << "): " << cs.full_runs << " full runs, "
+                  << cs.steps << " incremental steps\n";
+        std::cout << "  Moved " << cs.blocks_moved << " blocks, " << cs.bytes_moved << " bytes\n";
+        std::cout << "  Allocations rescued by compaction: " << cs.rescued << "\n";
+        // Wall-clock time varies run to run; on stderr it stays out of redirected logs.
+        std::cerr << "  Compaction time: " << std::fixed << std::setprecision(3) << cs.seconds * 1000.0 << " ms\n";
+    }
 }
 
 void MemoryManagerSimulator::visualize() const {
@@ -2,28 +2,64 @@
 #define MEMORY_MANAGER_H
 #include <cstdint>   
 #include <cstddef>
-#include <list>
-
-struct Block {
-    size_t start = 0;
-    size_t size = 0;
-    bool free = true;
-    int id = -1;
-    size_t requested = 0;
-    size_t internal_frag = 0;
-
-    Block() = default;
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "block_store.h"
+#include "node_pool.h"
 
-    Block(size_t s, size_t sz, bool f, int i, size_t req)
-        : start(s), size(sz), free(f), id(i), requested(req) {
-        internal_frag = sz > req ? sz - req : 0;
-    }
-};
+class FragTelemetry;
+class ImageWriter;
+class ImageFile;
 
 enum class AllocatorType {
     FIRST_FIT,
     BEST_FIT,
-    WORST_FIT
+    WORST_FIT,
+    NEXT_FIT,   // first fit starting from where the last allocation ended
+    TLSF        // two-level segregated fit, O(1) good-fit search
+};
+
+const char *allocator_name(AllocatorType type);
+bool parse_allocator_type(const std::string &name, AllocatorType &out);
+
+// What happens when the heap fragments. Compaction relocates live blocks
+// towards address 0; ids stay valid, their addresses change.
+enum class CompactionMode {
+    OFF,
+    FULL,          // slide every live block down in one pass
+    INCREMENTAL    // move a bounded number of bytes per malloc/free
+};
+
+const char *compaction_name(CompactionMode mode);
+bool parse_compaction_mode(const std::string &name, CompactionMode &out);
+
+struct CompactionStats {
+    uint64_t full_runs = 0;
+    uint64_t steps = 0;          // incremental slices that moved at least one block
+    uint64_t blocks_moved = 0;
+    uint64_t bytes_moved = 0;    // the relocation cost: every moved byte is copied once
+    uint64_t rescued = 0;        // mallocs that only succeeded after compacting
+    double seconds = 0.0;
+};
+
+// Point-in-time counters, maintained incrementally so a snapshot is O(1).
+struct MemoryStats {
+    size_t total = 0;
+    size_t used = 0;
+    size_t free = 0;
+    size_t largest_free = 0;
+    size_t free_blocks = 0;
+    size_t internal_frag = 0;
+    uint64_t alloc_success = 0;
+    uint64_t alloc_fail = 0;
+
+    double utilization() const { return total ? (double)used / total * 100.0 : 0.0; }
+    double external_frag() const { return free ? (1.0 - (double)largest_free / free) * 100.0 : 0.0; }
+    uint64_t requests() const { return alloc_success + alloc_fail; }
+    double success_rate() const { return requests() ? (double)alloc_success / requests() * 100.0 : 0.0; }
 };
 
 class MemoryManagerSimulator {
@@ -32,28 +68,122 @@ public:
 
     void init(size_t total_size);
     void setAllocator(AllocatorType type);
+    // Compaction starts when a malloc fails although enough bytes are free,
+    // or when external fragmentation reaches `threshold_pct` (0 = failures
+    // only). INCREMENTAL then moves up to `budget` bytes per operation until
+    // the failed size fits and fragmentation is back under the threshold;
+    // unspent budget carries over, so blocks larger than the budget still move.
+    void setCompaction(CompactionMode mode, unsigned threshold_pct = 0, size_t budget = 4096);
+    void compact();
+    const CompactionStats &compaction_stats() const { return compaction_totals; }
     void visualize() const;
 
     int malloc_block(size_t size);
     bool free_block(int block_id);
+    // Start address (and allocated size) of a live block; false for
+    // unknown or freed ids.
+    bool block_address(int block_id, size_t &start) const;
+    bool block_extent(int block_id, size_t &start, size_t &size) const;
 
     void dump() const;
     void stats() const;
+    MemoryStats snapshot() const;
+    // Free-block counts by floor(log2(size)); the last bin takes the rest.
+    void free_histogram(uint32_t *out, size_t bins) const;
+
+    // Samples the heap into `t` every N malloc/free calls; nullptr detaches.
+    void attach_telemetry(FragTelemetry *t) { telemetry = t; }
+
+    // Snapshot image sections ("mm.*"). Loading checks the whole block list
+    // before touching the heap, then rebuilds the free index from it.
+    void save_image(ImageWriter &img) const;
+    bool load_image(const ImageFile &img, std::string &err);
+
+    // Host allocator calls made by the block store, free index and id table.
+    // The store and index stop growing once the heap reaches its working-set
+    // size, but ids are never reused, so the id table (one 4-byte BlockRef per
+    // id ever issued) still grows geometrically: O(log mallocs) calls.
+    uint64_t host_allocations() const;
 
 private:
-    std::list<Block> blocks;
+    BlockStore blocks;
     AllocatorType allocator;
     size_t memory_size = 0;
-    int alloc_success = 0;
-    int alloc_fail = 0;
+    uint64_t alloc_success = 0;
+    uint64_t alloc_fail = 0;
     size_t internal_frag = 0;
+    size_t used_mem = 0;
     uint64_t next_id = 1;
     int total_requests = 0;
     uint64_t time = 0;
+    FragTelemetry *telemetry = nullptr;
+
+    CompactionMode compaction = CompactionMode::OFF;
+    unsigned compact_threshold = 0;
+    size_t compact_budget = 4096;
+    size_t compact_credit = 0;
+    bool compacting = false;   // a compaction cycle is in progress
+    size_t compact_goal = 0;   // largest failed request of the cycle
+    CompactionStats compaction_totals;
+
+    // Free-block index kept in sync with `blocks`: segregated bins keyed by
+    // floor(log2(size)) hold free blocks in address order (first fit), and a
+    // (size, start) ordered map serves best/worst fit.
+    using FreeBin = std::map<size_t, BlockRef, std::less<size_t>,
+                             PoolAllocator<std::pair<const size_t, BlockRef>>>;
+    using SizeKey = std::pair<size_t, size_t>;
+    using SizeIndex = std::map<SizeKey, BlockRef, std::less<SizeKey>,
+                               PoolAllocator<std::pair<const SizeKey, BlockRef>>>;
+
+    static constexpr size_t NUM_BINS = 64;
+    NodeArena index_arena;
+    std::vector<FreeBin> free_bins;
+    uint64_t bin_mask = 0;
+    SizeIndex free_by_size;
+
+    // Free blocks of size 0 (a freed `malloc 0` between live blocks) fit only
+    // zero-byte requests, so they stay out of the index; while any exist, a
+    // zero-byte first or best fit walks the list as the linear scans did.
+    size_t empty_free = 0;
+
+    // Next fit: the block after the last allocation. When coalescing absorbs
+    // it, the rover moves to the block that absorbed it.
+    BlockRef rover = NIL_BLOCK;
+
+    // TLSF: sizes map to a first level (power of two) and one of 16 linear
+    // second-level ranges inside it; each (fl, sl) pair heads an intrusive
+    // LIFO list of free blocks, and two bitmap levels find a non-empty list
+    // with two bit scans.
+    static constexpr unsigned TLSF_SL_BITS = 4;
+    static constexpr size_t TLSF_SL_COUNT = 1 << TLSF_SL_BITS;
+    static constexpr size_t TLSF_FL_COUNT = 64 - TLSF_SL_BITS + 1;
+    uint64_t tlsf_fl_mask = 0;
+    uint32_t tlsf_sl_mask[TLSF_FL_COUNT] = {};
+    BlockRef tlsf_heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+    // id -> block handle; ids are handed out densely from next_id, so a
+    // vector indexed by id replaces a search. Freed ids hold NIL_BLOCK.
+    std::vector<BlockRef> id_table;
+    uint64_t id_table_allocs = 0;
+
+    static size_t size_class(size_t size);
+    static void tlsf_mapping(size_t size, size_t &fl, size_t &sl);
+    void index_insert(BlockRef r);
+    void index_erase(BlockRef r);
+    void coalesce(BlockRef r);
+
+    BlockRef find_fit(size_t size);
+    BlockRef find_empty_fit() const;
+    BlockRef lowest_free() const;
+    void after_op();
+    void compact_slice(size_t budget);
+    bool compaction_done() const;
 
-    std::list<Block>::iterator find_first_fit(size_t size);
-    std::list<Block>::iterator find_best_fit(size_t size);
-    std::list<Block>::iterator find_worst_fit(size_t size);
+    BlockRef find_first_fit(size_t size, size_t from = 0);
+    BlockRef find_next_fit(size_t size);
+    BlockRef find_tlsf(size_t size);
+    BlockRef find_best_fit(size_t size);
+    BlockRef find_worst_fit(size_t size);
 
 };
 
@@ -0,0 +1,98 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Recycling arena for small fixed-size nodes (the tree nodes behind the
+// free-block index). Freed nodes go onto a per-size free list and are handed
+// back out before a new chunk is carved, so a simulator in steady state makes
+// no calls into the host allocator. `allocations()` counts the calls it did make.
+class NodeArena {
+public:
+    NodeArena() = default;
+    NodeArena(const NodeArena &) = delete;
+    NodeArena &operator=(const NodeArena &) = delete;
+
+    ~NodeArena() {
+        while (chunks) {
+            Chunk *prev = chunks->prev;
+            ::operator delete(chunks);
+            chunks = prev;
+        }
+    }
+
+    void *allocate(size_t bytes) {
+        size_t c = slot_class(bytes);
+        if (c >= NUM_CLASSES) {
+            host_allocs++;
+            return ::operator new(bytes);
+        }
+        if (FreeNode *n = free_lists[c]) {
+            free_lists[c] = n->next;
+            return n;
+        }
+        size_t slot = (c + 1) * SLOT_ALIGN;
+        if (!chunks || chunk_used + slot > CHUNK_BYTES) {
+            Chunk *ch = static_cast<Chunk *>(::operator new(sizeof(Chunk) + CHUNK_BYTES));
+            ch->prev = chunks;
+            chunks = ch;
+            chunk_used = 0;
+            host_allocs++;
+        }
+        void *p = reinterpret_cast<char *>(chunks + 1) + chunk_used;
+        chunk_used += slot;
+        return p;
+    }
+
+    void deallocate(void *p, size_t bytes) {
+        size_t c = slot_class(bytes);
+        if (c >= NUM_CLASSES) {
+            ::operator delete(p);
+            return;
+        }
+        FreeNode *n = static_cast<FreeNode *>(p);
+        n->next = free_lists[c];
+        free_lists[c] = n;
+    }
+
+    uint64_t allocations() const { return host_allocs; }
+
+private:
+    static constexpr size_t SLOT_ALIGN = 16;
+    static constexpr size_t NUM_CLASSES = 8;  // nodes up to 128 bytes
+    static constexpr size_t CHUNK_BYTES = 64 * 1024;
+
+    struct FreeNode { FreeNode *next; };
+    struct alignas(SLOT_ALIGN) Chunk { Chunk *prev; };
+
+    static size_t slot_class(size_t bytes) { return (bytes + SLOT_ALIGN - 1) / SLOT_ALIGN - 1; }
+
+    FreeNode *free_lists[NUM_CLASSES] = {};
+    Chunk *chunks = nullptr;
+    size_t chunk_used = 0;
+    uint64_t host_allocs = 0;
+};
+
+// std-compatible allocator that draws single nodes from a NodeArena.
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(NodeArena *a) : arena(a) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T))); }
+    void deallocate(T *p, size_t n) { arena->deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &o) const { return arena == o.arena; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &o) const { return arena != o.arena; }
+
+    NodeArena *arena;
+};
+
+#endif
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../allocator/memory_manager.h"
+#include "../buddy/buddy_allocator.h"
+#include "../cache/multilevel_cache.h"
+#include "workload.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Benchmark driver behind `make bench`: every allocator strategy, both buddy
+// engines and every cache policy against the synthetic workloads of
+// workload.h, reported as one JSON document.
+//
+// Each configuration runs twice on fresh simulators: an untimed-per-op pass
+// for ops/s, then a pass that times every operation for the ns/op
+// percentiles (the clock reads would otherwise inflate the throughput).
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchResult {
+    std::string suite;
+    std::string name;
+    std::string workload;
+    uint64_t ops = 0;
+    uint64_t failures = 0;
+    double seconds = 0;
+    uint64_t p50 = 0, p90 = 0, p99 = 0, p999 = 0;
+    long peak_rss_kb = 0;
+    uint64_t bytes_moved = 0;   // compaction suite only
+};
+
+// Peak resident set size. On Linux the high-water mark is reset before each
+// configuration, so the figure is per configuration; elsewhere it is the
+// process peak so far.
+void reset_peak_rss() {
+#if defined(__linux__)
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd >= 0) {
+        ssize_t ignored = write(fd, "5", 1);
+        (void)ignored;
+        close(fd);
+    }
+#endif
+}
+
+long peak_rss_kb() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return (long)(pmc.PeakWorkingSetSize / 1024);
+    return 0;
+#elif defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::strtol(line.c_str() + 6, nullptr, 10);
+    return 0;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+#endif
+}
+
+void percentiles(std::vector<uint32_t> &ns, BenchResult &r) {
+    if (ns.empty()) return;
+    std::sort(ns.begin(), ns.end());
+    auto at = [&](double q) { return (uint64_t)ns[std::min(ns.size() - 1, (size_t)(q * ns.size()))]; };
+    r.p50 = at(0.50);
+    r.p90 = at(0.90);
+    r.p99 = at(0.99);
+    r.p999 = at(0.999);
+}
+
+// Runs `step(i)` for i in [0, n) once for throughput and once per-op timed.
+// `fresh` rebuilds the simulator between the passes.
+template <typename Fresh, typename Step>
+void measure(size_t n, Fresh fresh, Step step, BenchResult &r) {
+    reset_peak_rss();
+    fresh();
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < n; i++) r.failures += !step(i);
+    r.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    fresh();
+    std::vector<uint32_t> ns(n);
+    for (size_t i = 0; i < n; i++) {
+        auto a = Clock::now();
+        step(i);
+        ns[i] = (uint32_t)std::min<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - a).count(),
+                                           UINT32_MAX);
+    }
+    r.ops = n;
+    percentiles(ns, r);
+    r.peak_rss_kb = peak_rss_kb();
+}
+
+const SizeDist SIZE_DISTS[] = {SizeDist::UNIFORM, SizeDist::ZIPF, SizeDist::BIMODAL};
+const FreeOrder FREE_ORDERS[] = {FreeOrder::LIFO, FreeOrder::FIFO, FreeOrder::RANDOM};
+const AddressStream STREAMS[] = {AddressStream::SEQUENTIAL, AddressStream::STRIDED, AddressStream::ZIPF};
+
+constexpr size_t HEAP_SIZE = (size_t)64 << 20;
+constexpr size_t LIVE_TARGET = 4096;
+constexpr uint64_t FOOTPRINT = (uint64_t)4 << 20;
+// The most bytes a workload ever holds at once (sizes rounded as malloc_block
+// rounds them): a heap of exactly this size only fails through fragmentation.
+size_t peak_live_bytes(const std::vector<AllocOp> &work) {
+    std::vector<size_t> sizes;
+    size_t live = 0, peak = 0;
+    for (const AllocOp &op : work) {
+        if (op.free) {
+            live -= sizes[op.value];
+        } else {
+            sizes.push_back(op.value ? (op.value + 15) & ~(size_t)15 : 16);
+            live += sizes.back();
+        }
+        peak = std::max(peak, live);
+    }
+    return peak;
+}
+
+void bench_allocators(size_t ops, uint64_t seed, std::vector<BenchResult> &out) {
+    const AllocatorType types[] = {AllocatorType::FIRST_FIT, AllocatorType::BEST_FIT, AllocatorType::WORST_FIT,
+                                   AllocatorType::NEXT_FIT, AllocatorType::TLSF};
+    for (SizeDist sizes : SIZE_DISTS)
+        for (FreeOrder order : FREE_ORDERS) {
+            std::vector<AllocOp> work = make_alloc_workload(sizes, order, ops, LIVE_TARGET, seed);
+            for (AllocatorType type : types) {
+                BenchResult r;
+                r.suite = "allocator";
+                r.name = allocator_name(type);
+                r.workload = std::string(size_dist_name(sizes)) + "/" + free_order_name(order);
+                std::unique_ptr<MemoryManagerSimulator> mm;
+                std::vector<int> ids;
+                size_t next = 0;
+                auto fresh = [&]() {
+                    mm.reset(new MemoryManagerSimulator);
+                    mm->init(HEAP_SIZE);
+                    mm->setAllocator(type);
+                    ids.assign(work.size(), -1);
+                    next = 0;
+                };
+                auto step = [&](size_t i) {
+                    const AllocOp &op = work[i];
+                    if (op.free) return mm->free_block(ids[op.value]);
+                    ids[next++] = mm->malloc_block(op.value);
+                    return ids[next - 1] != -1;
+                };
+                measure(work.size(), fresh, step, r);
+                out.push_back(r);
+                std::cerr << r.suite << " " << r.name << " " << r.workload << "\n";
+            }
+        }
+}
+
+// Compaction against simply picking another fit: each workload on a heap
+// just large enough for its peak live bytes, where `failures` shows the
+// success gain and ops/s / bytes_moved the cost.
+void bench_compaction(size_t ops, uint64_t seed, std::vector<BenchResult> &out) {
+    const AllocatorType types[] = {AllocatorType::FIRST_FIT, AllocatorType::BEST_FIT, AllocatorType::TLSF};
+    const CompactionMode modes[] = {CompactionMode::OFF, CompactionMode::FULL, CompactionMode::INCREMENTAL};
+    for (SizeDist sizes : SIZE_DISTS) {
+        std::vector<AllocOp> work = make_alloc_workload(sizes, FreeOrder::RANDOM, ops, LIVE_TARGET, seed);
+        size_t heap = peak_live_bytes(work);
+        for (AllocatorType type : types)
+            for (CompactionMode mode : modes) {
+                BenchResult r;
+                r.suite = "compaction";
+                r.name = std::string(allocator_name(type)) + "+" + compaction_name(mode);
+                r.workload = std::string(size_dist_name(sizes)) + "/" + free_order_name(FreeOrder::RANDOM);
+                std::unique_ptr<MemoryManagerSimulator> mm;
+                std::vector<int> ids;
+                size_t next = 0;
+                auto fresh = [&]() {
+                    mm.reset(new MemoryManagerSimulator);
+                    mm->init(heap);
+                    mm->setAllocator(type);
+                    mm->setCompaction(mode);
+                    ids.assign(work.size(), -1);
+                    next = 0;
+                };
+                auto step = [&](size_t i) {
+                    const AllocOp &op = work[i];
+                    if (op.free) return ids[op.value] == -1 || mm->free_block(ids[op.value]);
+                    ids[next++] = mm->malloc_block(op.value);
+                    return ids[next - 1] != -1;
+                };
+                measure(work.size(), fresh, step, r);
+                r.bytes_moved = mm->compaction_stats().bytes_moved;
+                out.push_back(r);
+                std::cerr << r.suite << " " << r.name << " " << r.workload << "\n";
+            }
+    }
+}
+
+void bench_buddy(size_t ops, uint64_t seed, std::vector<BenchResult> &out) {
+    const BuddyEngine engines[] = {BuddyEngine::FREE_LIST, BuddyEngine::BITMAP};
+    for (SizeDist sizes : SIZE_DISTS)
+        for (FreeOrder order : FREE_ORDERS) {
+            std::vector<AllocOp> work = make_alloc_workload(sizes, order, ops, LIVE_TARGET, seed);
+            for (BuddyEngine engine : engines) {
+                BenchResult r;
+                r.suite = "buddy";
+                r.name = engine == BuddyEngine::BITMAP ? "bitmap" : "free_list";
+                r.workload = std::string(size_dist_name(sizes)) + "/" + free_order_name(order);
+                std::unique_ptr<BuddyAllocator> ba;
+                std::vector<int> ids;
+                size_t next = 0;
+                auto fresh = [&]() {
+                    ba.reset(new BuddyAllocator(HEAP_SIZE, engine, 16));
+                    ids.assign(work.size(), -1);
+                    next = 0;
+                };
+                auto step = [&](size_t i) {
+                    const AllocOp &op = work[i];
+                    if (op.free) return ba->freeBlock(ids[op.value]).ok();
+                    ids[next++] = ba->allocate(op.value).id;
+                    return ids[next - 1] != -1;
+                };
+                measure(work.size(), fresh, step, r);
+                out.push_back(r);
+                std::cerr << r.suite << " " << r.name << " " << r.workload << "\n";
+            }
+        }
+}
+
+void bench_caches(size_t accesses, uint64_t seed, std::vector<BenchResult> &out) {
+    const CachePolicy policies[] = {CachePolicy::FIFO, CachePolicy::LRU, CachePolicy::LFU, CachePolicy::PLRU,
+                                    CachePolicy::SRRIP};
+    for (AddressStream stream : STREAMS) {
+        std::vector<uint64_t> addrs = make_address_stream(stream, accesses, FOOTPRINT, seed);
+        for (CachePolicy policy : policies) {
+            BenchResult r;
+            r.suite = "cache";
+            r.name = policy_name(policy);
+            r.workload = address_stream_name(stream);
+            // 32 KiB 8-way L1 over a 256 KiB 16-way L2, both with the policy under test
+            HierarchyConfig config;
+            config.levels.push_back({32 * 1024, 64, 8, policy});
+            config.levels.push_back({256 * 1024, 64, 16, policy});
+            std::unique_ptr<MultiLevelCache> cache;
+            auto fresh = [&]() { cache.reset(new MultiLevelCache(config)); };
+            auto step = [&](size_t i) {
+                cache->access(addrs[i], (i & 7) == 0);
+                return true;
+            };
+            measure(addrs.size(), fresh, step, r);
+            out.push_back(r);
+            std::cerr << r.suite << " " << r.name << " " << r.workload << "\n";
+        }
+    }
+}
+
+void print_json(std::ostream &os, uint64_t seed, size_t ops, size_t accesses, const std::vector<BenchResult> &results) {
+    os << "{\n  \"schema\": 2,\n  \"seed\": " << seed << ",\n  \"alloc_ops\": " << ops
+       << ",\n  \"cache_accesses\": " << accesses << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        os << "    {\"suite\": \"" << r.suite << "\", \"name\": \"" << r.name << "\", \"workload\": \"" << r.workload
+           << "\", \"ops\": " << r.ops << ", \"failures\": " << r.failures << ", \"seconds\": " << r.seconds
+           << ", \"ops_per_sec\": " << (r.seconds > 0 ? (uint64_t)(r.ops / r.seconds) : 0) << ", \"ns_p50\": " << r.p50
+           << ", \"ns_p90\": " << r.p90 << ", \"ns_p99\": " << r.p99 << ", \"ns_p999\": " << r.p999
+           << ", \"peak_rss_kb\": " << r.peak_rss_kb << ", \"bytes_moved\": " << r.bytes_moved << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    size_t ops = 200000, accesses = 1000000;
+    uint64_t seed = 42;
+    std::string out_path;
+    std::vector<std::string> suites;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--ops" && i + 1 < argc) ops = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--accesses" && i + 1 < argc) accesses = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && i + 1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--out" && i + 1 < argc) out_path = argv[++i];
+        else if (arg == "--suite" && i + 1 < argc) suites.push_back(argv[++i]);
+        else {
+            std::cout << "Usage: memsim_bench [--ops N] [--accesses N] [--seed S] [--out file.json]"
+                         " [--suite allocator|compaction|buddy|cache]...\n";
+            return 1;
+        }
+    }
+    auto wanted = [&](const char *s) { return suites.empty() || std::find(suites.begin(), suites.end(), s) != suites.end(); };
+
+    std::vector<BenchResult> results;
+    if (wanted("allocator")) bench_allocators(ops, seed, results);
+    if (wanted("compaction")) bench_compaction(ops, seed, results);
+    if (wanted("buddy")) bench_buddy(ops, seed, results);
+    if (wanted("cache")) bench_caches(accesses, seed, results);
+
+    if (out_path.empty()) {
+        print_json(std::cout, seed, ops, accesses, results);
+        return 0;
+    }
+    std::ofstream out(out_path);
+    if (!out) {
+        std::cout << "Cannot write " << out_path << "\n";
+        return 1;
+    }
+    print_json(out, seed, ops, accesses, results);
+    std::cout << "Wrote " << results.size() << " results to " << out_path << "\n";
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "workload.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+const char *size_dist_name(SizeDist d) {
+    switch (d) {
+    case SizeDist::UNIFORM: return "uniform";
+    case SizeDist::ZIPF: return "zipf";
+    case SizeDist::BIMODAL: return "bimodal";
+    }
+    return "?";
+}
+
+const char *free_order_name(FreeOrder o) {
+    switch (o) {
+    case FreeOrder::LIFO: return "lifo";
+    case FreeOrder::FIFO: return "fifo";
+    case FreeOrder::RANDOM: return "random";
+    }
+    return "?";
+}
+
+const char *address_stream_name(AddressStream s) {
+    switch (s) {
+    case AddressStream::SEQUENTIAL: return "sequential";
+    case AddressStream::STRIDED: return "strided";
+    case AddressStream::ZIPF: return "zipf";
+    }
+    return "?";
+}
+
+ZipfSampler::ZipfSampler(size_t n, double s) : cdf(n) {
+    double sum = 0;
+    for (size_t k = 0; k < n; k++) {
+        sum += 1.0 / std::pow((double)(k + 1), s);
+        cdf[k] = sum;
+    }
+    for (double &c : cdf) c /= sum;
+}
+
+size_t ZipfSampler::sample(SplitMix64 &rng) const {
+    double u = rng.unit();
+    size_t k = std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    return std::min(k, cdf.size() - 1);
+}
+
+std::vector<AllocOp> make_alloc_workload(SizeDist sizes, FreeOrder order, size_t ops, size_t live_target,
+                                         uint64_t seed) {
+    SplitMix64 rng(seed);
+    ZipfSampler zipf(64, 1.1);
+    std::vector<AllocOp> out;
+    out.reserve(ops + live_target);
+    std::deque<uint64_t> live;   // malloc sequence numbers, oldest first
+    uint64_t mallocs = 0;
+
+    auto next_size = [&]() -> uint64_t {
+        switch (sizes) {
+        case SizeDist::UNIFORM: return 16 + rng.below(1024 - 16 + 1);
+        case SizeDist::ZIPF: return 16 * (zipf.sample(rng) + 1);
+        case SizeDist::BIMODAL:
+            return rng.below(10) ? 16 + rng.below(128 - 16 + 1) : 2048 + rng.below(8192 - 2048 + 1);
+        }
+        return 16;
+    };
+    auto next_free = [&]() -> uint64_t {
+        uint64_t seq;
+        if (order == FreeOrder::LIFO) {
+            seq = live.back();
+            live.pop_back();
+        } else if (order == FreeOrder::FIFO) {
+            seq = live.front();
+            live.pop_front();
+        } else {
+            size_t i = rng.below(live.size());
+            seq = live[i];
+            live[i] = live.back();
+            live.pop_back();
+        }
+        return seq;
+    };
+
+    while (out.size() < ops) {
+        bool do_malloc = live.size() < live_target ? true : live.size() >= 2 * live_target ? false : rng.below(2) == 0;
+        if (live.empty()) do_malloc = true;
+        if (do_malloc) {
+            out.push_back({false, next_size()});
+            live.push_back(mallocs++);
+        } else {
+            out.push_back({true, next_free()});
+        }
+    }
+    while (!live.empty()) out.push_back({true, next_free()});
+    return out;
+}
+
+std::vector<uint64_t> make_address_stream(AddressStream stream, size_t accesses, uint64_t footprint, uint64_t seed) {
+    SplitMix64 rng(seed);
+    std::vector<uint64_t> out(accesses);
+    uint64_t blocks = std::max<uint64_t>(footprint / 64, 1);
+    switch (stream) {
+    case AddressStream::SEQUENTIAL:
+        for (size_t i = 0; i < accesses; i++) out[i] = (i * 8) % footprint;
+        break;
+    case AddressStream::STRIDED:
+        for (size_t i = 0; i < accesses; i++) out[i] = (i * (4096 + 64)) % footprint;
+        break;
+    case AddressStream::ZIPF: {
+        ZipfSampler zipf(blocks, 0.99);
+        // an odd multiplier permutes ranks over a power-of-two block count,
+        // so the hottest blocks do not share neighbouring sets
+        for (size_t i = 0; i < accesses; i++)
+            out[i] = ((zipf.sample(rng) * 0x9e3779b1ULL) % blocks) * 64 + rng.below(8) * 8;
+        break;
+    }
+    }
+    return out;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Synthetic workloads for the benchmark suite. Every generator is driven by
+// its own splitmix64 stream and samples by hand rather than through the
+// implementation-defined <random> distributions, so a seed gives the same
+// workload with every standard library.
+
+enum class SizeDist {
+    UNIFORM,   // 16 .. 1024 bytes
+    ZIPF,      // multiples of 16 up to 1 KiB, small sizes most frequent
+    BIMODAL    // 90% 16 .. 128 bytes, 10% 2 .. 8 KiB
+};
+
+enum class FreeOrder {
+    LIFO,      // newest live block first
+    FIFO,      // oldest live block first
+    RANDOM
+};
+
+enum class AddressStream {
+    SEQUENTIAL,   // 8-byte steps through the footprint
+    STRIDED,      // one 4 KiB + 64 byte stride per access
+    ZIPF          // 64-byte blocks, Zipf(0.99) popularity, hot blocks scattered
+};
+
+const char *size_dist_name(SizeDist d);
+const char *free_order_name(FreeOrder o);
+const char *address_stream_name(AddressStream s);
+
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    uint64_t below(uint64_t n) { return next() % n; }
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    uint64_t state;
+};
+
+// Ranks 0 .. n-1 with P(k) proportional to 1 / (k + 1)^s, by binary search
+// over a precomputed CDF.
+class ZipfSampler {
+public:
+    ZipfSampler(size_t n, double s);
+    size_t sample(SplitMix64 &rng) const;
+
+private:
+    std::vector<double> cdf;
+};
+
+// One allocator operation. A malloc carries its size; a free names the
+// allocation to release by its sequence number among the mallocs, which the
+// runner maps to whatever id the allocator returned.
+struct AllocOp {
+    bool free;
+    uint64_t value;
+};
+
+// Ramps up to `live_target` live blocks, then keeps the heap in steady state
+// with an even malloc/free mix, and finally frees everything.
+std::vector<AllocOp> make_alloc_workload(SizeDist sizes, FreeOrder order, size_t ops, size_t live_target,
+                                         uint64_t seed);
+
+std::vector<uint64_t> make_address_stream(AddressStream stream, size_t accesses, uint64_t footprint, uint64_t seed);
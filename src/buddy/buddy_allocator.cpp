@@ -1,7 +1,29 @@
 #include "buddy_allocator.h"
+#include "../profile/profile.h"
+#include "../snapshot/snapshot.h"
+#include <algorithm>
+#include <iterator>
 
-BuddyAllocator::BuddyAllocator(size_t total_size)
-    : memory_size(total_size), total_memory(total_size), alloc_success(0), alloc_fail(0)
+namespace {
+
+struct BuddyImage {
+    uint64_t memory_size;
+    uint64_t min_block;
+    uint32_t engine;
+    uint32_t pad;
+    uint64_t next_id;
+    uint64_t alloc_success;
+    uint64_t alloc_fail;
+    uint64_t used_mem;
+    uint64_t total_splits;
+    uint64_t total_merges;
+    uint64_t order_mask;
+};
+
+}  // namespace
+
+BuddyAllocator::BuddyAllocator(size_t total_size, BuddyEngine engine_type, size_t min_block_size)
+    : memory_size(total_size), total_memory(total_size), engine(engine_type), min_block(1), alloc_success(0), alloc_fail(0)
 {
     size_t power = 1;
     while (power < total_size) power *= 2;
@@ -10,7 +32,29 @@ BuddyAllocator::BuddyAllocator(size_t total_size)
         memory_size = power;
         total_memory = power;
     }
-    free_lists[memory_size].push_back(BuddyBlock(0, memory_size, -1));
+    while (min_block < min_block_size && min_block < memory_size) min_block *= 2;
+
+    top_order = __builtin_ctzll(memory_size);
+    min_shift = __builtin_ctzll(min_block);
+    if (engine == BuddyEngine::BITMAP && (memory_size >> min_shift) >= NIL) {
+        std::cout << "Bitmap engine needs fewer than 2^32 minimum blocks; using free lists\n";
+        engine = BuddyEngine::FREE_LIST;
+    }
+
+    allocated_blocks.resize(1);
+    if (engine == BuddyEngine::FREE_LIST) {
+        free_lists[memory_size].push_back(BuddyBlock(0, memory_size, -1));
+        return;
+    }
+
+    order_bits.resize(top_order + 1);
+    for (unsigned k = min_shift; k <= top_order; k++)
+        order_bits[k].assign((((uint64_t)memory_size >> k) + 63) / 64, 0);
+    fifo_next.assign(memory_size >> min_shift, NIL);
+    fifo_prev.assign(memory_size >> min_shift, NIL);
+    std::fill(std::begin(fifo_head), std::end(fifo_head), NIL);
+    std::fill(std::begin(fifo_tail), std::end(fifo_tail), NIL);
+    pushFree(0, top_order);
 }
 
 
@@ -31,48 +75,75 @@ uint64_t BuddyAllocator::getBuddy(uint64_t addr, uint64_t size) {
     return addr ^ size;
 }
 
-int BuddyAllocator::allocate(uint64_t request_size) {
-    uint64_t actual_size = nextPowerOf2(request_size);
+BuddyResult BuddyAllocator::allocate(uint64_t request_size) {
+    MEMSIM_PROFILE_SCOPE(ProfOp::BUDDY_ALLOC);
+    uint64_t actual_size = std::max(nextPowerOf2(request_size), min_block);
+    BuddyResult res;
+
+    bool ok = actual_size <= memory_size &&
+              (engine == BuddyEngine::BITMAP ? allocateBitmap(actual_size, res)
+                                             : allocateList(actual_size, res));
+    if (!ok) {
+        alloc_fail++;
+        return res;
+    }
+
+    alloc_success++;
+    res.id = next_id++;
+    res.order = __builtin_ctzll(actual_size);
+    allocated_blocks.push_back(BuddyBlock(res.address, actual_size, res.id));
+    used_mem += actual_size;
+    total_splits += res.splits;
+    MEMSIM_PROFILE_COUNT(ProfCounter::SPLIT_DEPTH, res.splits);
+    return res;
+}
+
+
+BuddyResult BuddyAllocator::freeBlock(int block_id) {
+    MEMSIM_PROFILE_SCOPE(ProfOp::BUDDY_FREE);
+    BuddyResult res;
+    if (block_id <= 0 || (uint64_t)block_id >= next_id || allocated_blocks[block_id].size == 0)
+        return res;
+
+    BuddyBlock block = allocated_blocks[block_id];
+    allocated_blocks[block_id].size = 0;
+    used_mem -= block.size;
+
+    if (engine == BuddyEngine::BITMAP) releaseBitmap(block, res);
+    else releaseList(block, res);
+
+    res.id = block_id;
+    total_merges += res.merges;
+    MEMSIM_PROFILE_COUNT(ProfCounter::MERGE_DEPTH, res.merges);
+    return res;
+}
+
+
+bool BuddyAllocator::allocateList(uint64_t actual_size, BuddyResult &res) {
     uint64_t curr_size = actual_size;
 
     while (curr_size <= memory_size && free_lists[curr_size].empty()) {
         curr_size *= 2;
     }
 
-    if (curr_size > memory_size || free_lists[curr_size].empty()) {
-        alloc_fail++;
-        std::cout << "Buddy allocation failed\n";
-        return -1;
-    }
+    if (curr_size > memory_size || free_lists[curr_size].empty())
+        return false;
 
-    alloc_success++;
     auto block = free_lists[curr_size].front();
     free_lists[curr_size].pop_front();
     while (curr_size > actual_size) {
         curr_size /= 2;
         uint64_t buddy_addr = getBuddy(block.start, curr_size);
         free_lists[curr_size].push_back(BuddyBlock(buddy_addr, curr_size, -1));
+        res.splits++;
     }
 
-    int id = next_id++;
-    allocated_blocks[id] = BuddyBlock(block.start, curr_size, id);
-
-    std::cout << "Allocated buddy block id=" << id
-              << " at address 0x" << std::hex << block.start << std::dec << "\n";
-
-    return id;
+    res.address = block.start;
+    return true;
 }
 
 
-bool BuddyAllocator::freeBlock(int block_id) {
-    if (!allocated_blocks.count(block_id)) {
-        std::cout << "Invalid buddy block ID\n";
-        return false;
-    }
-
-    auto block = allocated_blocks[block_id];
-    allocated_blocks.erase(block_id);
-
+void BuddyAllocator::releaseList(BuddyBlock block, BuddyResult &res) {
     while (true) {
         uint64_t buddy_addr = getBuddy(block.start, block.size);
         bool merged = false;
@@ -83,6 +154,7 @@ bool BuddyAllocator::freeBlock(int block_id) {
                 free_lists[block.size].erase(it);
                 block.size *= 2;
                 merged = true;
+                res.merges++;
                 break;
             }
         }
@@ -91,13 +163,87 @@ bool BuddyAllocator::freeBlock(int block_id) {
     }
 
     free_lists[block.size].push_back(BuddyBlock(block.start, block.size, -1));
-    std::cout << "Buddy block " << block_id << " freed and merged\n";
+    res.address = block.start;
+    res.order = __builtin_ctzll(block.size);
+}
+
+
+bool BuddyAllocator::isFree(uint64_t addr, unsigned order) const {
+    uint64_t pos = addr >> order;
+    return (order_bits[order][pos >> 6] >> (pos & 63)) & 1;
+}
+
+void BuddyAllocator::pushFree(uint64_t addr, unsigned order) {
+    uint64_t pos = addr >> order;
+    order_bits[order][pos >> 6] |= 1ULL << (pos & 63);
+
+    uint32_t slot = (uint32_t)(addr >> min_shift);
+    fifo_next[slot] = NIL;
+    fifo_prev[slot] = fifo_tail[order];
+    if (fifo_tail[order] != NIL) fifo_next[fifo_tail[order]] = slot;
+    else fifo_head[order] = slot;
+    fifo_tail[order] = slot;
+    order_mask |= 1ULL << order;
+}
+
+void BuddyAllocator::unlinkFree(uint64_t addr, unsigned order) {
+    uint64_t pos = addr >> order;
+    order_bits[order][pos >> 6] &= ~(1ULL << (pos & 63));
+
+    uint32_t slot = (uint32_t)(addr >> min_shift);
+    uint32_t nx = fifo_next[slot], pv = fifo_prev[slot];
+    if (pv != NIL) fifo_next[pv] = nx; else fifo_head[order] = nx;
+    if (nx != NIL) fifo_prev[nx] = pv; else fifo_tail[order] = pv;
+    if (fifo_head[order] == NIL) order_mask &= ~(1ULL << order);
+}
+
+bool BuddyAllocator::allocateBitmap(uint64_t actual_size, BuddyResult &res) {
+    unsigned want = __builtin_ctzll(actual_size);
+    uint64_t candidates = order_mask & (~0ULL << want);
+    if (!candidates) return false;
+
+    unsigned order = __builtin_ctzll(candidates);
+    uint64_t start = (uint64_t)fifo_head[order] << min_shift;
+    unlinkFree(start, order);
+    while (order > want) {
+        order--;
+        pushFree(getBuddy(start, 1ULL << order), order);
+        res.splits++;
+    }
+    res.address = start;
     return true;
 }
 
+void BuddyAllocator::releaseBitmap(BuddyBlock block, BuddyResult &res) {
+    unsigned order = __builtin_ctzll(block.size);
+    uint64_t start = block.start;
+    while (order < top_order) {
+        uint64_t buddy_addr = getBuddy(start, 1ULL << order);
+        if (!isFree(buddy_addr, order)) break;
+        unlinkFree(buddy_addr, order);
+        start = std::min(start, buddy_addr);
+        order++;
+        res.merges++;
+    }
+    pushFree(start, order);
+    res.address = start;
+    res.order = order;
+}
+
 
 void BuddyAllocator::dump() const {
     std::cout << "\n=== BUDDY MEMORY DUMP ===\n";
+    if (engine == BuddyEngine::BITMAP) {
+        for (unsigned k = min_shift; k <= top_order; k++)
+            for (uint32_t slot = fifo_head[k]; slot != NIL; slot = fifo_next[slot]) {
+                uint64_t start = (uint64_t)slot << min_shift;
+                std::cout << "[0x" << std::hex << start
+                          << " - 0x" << (start + (1ULL << k) - 1)
+                          << "] FREE\n";
+            }
+        std::cout << std::dec;
+        return;
+    }
     for (const auto &p : free_lists)
         for (const auto &blk : p.second)
             std::cout << "[0x" << std::hex << blk.start
@@ -106,19 +252,175 @@ void BuddyAllocator::dump() const {
     std::cout << std::dec;
 }
 
-void BuddyAllocator::stats() const {
-    size_t used = 0;
-    for (const auto &b : allocated_blocks) {
-        used += b.second.size;
+BuddyStats BuddyAllocator::snapshot() const {
+    BuddyStats st;
+    st.total = memory_size;
+    st.used = used_mem;
+    st.free = memory_size - used_mem;
+    if (engine == BuddyEngine::BITMAP) {
+        if (order_mask) st.largest_free = 1ULL << (63 - __builtin_clzll(order_mask));
+    } else {
+        for (auto it = free_lists.rbegin(); it != free_lists.rend(); ++it) {
+            if (!it->second.empty()) {
+                st.largest_free = it->first;
+                break;
+            }
+        }
     }
+    st.alloc_success = alloc_success;
+    st.alloc_fail = alloc_fail;
+    st.splits = total_splits;
+    st.merges = total_merges;
+    return st;
+}
 
-    size_t free_mem = memory_size - used;
-    double utilization = (double)used / memory_size * 100.0;
+void BuddyAllocator::stats() const {
+    BuddyStats st = snapshot();
 
     std::cout << "\n=== BUDDY ALLOCATOR STATS ===\n";
-    std::cout << "Total memory: " << memory_size << " bytes\n";
-    std::cout << "Used memory: " << used << " bytes\n";
-    std::cout << "Free memory: " << free_mem << " bytes\n";
-    std::cout << "Memory utilization: " << std::fixed << utilization << "%\n";
-    std::cout << "Total allocation requests: " << (alloc_success + alloc_fail) << "\n";
+    std::cout << "Total memory: " << st.total << " bytes\n";
+    std::cout << "Used memory: " << st.used << " bytes\n";
+    std::cout << "Free memory: " << st.free << " bytes\n";
+    std::cout << "Memory utilization: " << std::fixed << st.utilization() << "%\n";
+    std::cout << "Total allocation requests: " << st.requests() << "\n";
+    std::cout << "Splits: " << st.splits << "  Merges: " << st.merges << "\n";
+}
+
+void BuddyAllocator::saveImage(ImageWriter &img) const {
+    BuddyImage h{};
+    h.memory_size = memory_size;
+    h.min_block = min_block;
+    h.engine = (uint32_t)engine;
+    h.next_id = next_id;
+    h.alloc_success = alloc_success;
+    h.alloc_fail = alloc_fail;
+    h.used_mem = used_mem;
+    h.total_splits = total_splits;
+    h.total_merges = total_merges;
+    h.order_mask = order_mask;
+    img.addValue("buddy.state", h);
+    img.add("buddy.alloc", allocated_blocks);
+
+    if (engine == BuddyEngine::FREE_LIST) {
+        // Flattened smallest size first, each list in its own order.
+        std::vector<BuddyBlock> flat;
+        for (const auto &entry : free_lists) flat.insert(flat.end(), entry.second.begin(), entry.second.end());
+        img.addCopy("buddy.free", flat.data(), flat.size() * sizeof(BuddyBlock));
+        return;
+    }
+    for (unsigned k = min_shift; k <= top_order; k++) img.add("buddy.bits." + std::to_string(k), order_bits[k]);
+    img.add("buddy.next", fifo_next);
+    img.add("buddy.prev", fifo_prev);
+    img.add("buddy.head", fifo_head, sizeof(fifo_head));
+    img.add("buddy.tail", fifo_tail, sizeof(fifo_tail));
+}
+
+BuddyAllocator *BuddyAllocator::loadImage(const ImageFile &img, std::string &err) {
+    BuddyImage h;
+    if (!img.readValue("buddy.state", h)) {
+        err = "image has no buddy heap";
+        return nullptr;
+    }
+    // Geometry first: the constructor sizes the bitmap engine's arrays from
+    // it, so they must match the image's sections before anything is built.
+    size_t slots = 0;
+    bool shape = h.memory_size && !(h.memory_size & (h.memory_size - 1)) && h.min_block &&
+                 !(h.min_block & (h.min_block - 1)) && h.min_block <= h.memory_size &&
+                 h.engine <= (uint32_t)BuddyEngine::BITMAP && h.next_id >= 1 && h.next_id <= INT32_MAX;
+    if (shape && h.engine == (uint32_t)BuddyEngine::BITMAP)
+        shape = img.view<uint32_t>("buddy.next", slots) && slots == h.memory_size / h.min_block;
+    if (!shape) {
+        err = "buddy image is inconsistent";
+        return nullptr;
+    }
+    BuddyAllocator *ba = new BuddyAllocator(h.memory_size, (BuddyEngine)h.engine, h.min_block);
+    bool ok = ba->engine == (BuddyEngine)h.engine && ba->min_block == h.min_block &&
+              img.read("buddy.alloc", ba->allocated_blocks) && ba->allocated_blocks.size() == h.next_id;
+
+    if (ok && ba->engine == BuddyEngine::FREE_LIST) {
+        size_t n = 0;
+        const BuddyBlock *flat = img.view<BuddyBlock>("buddy.free", n);
+        ok = flat != nullptr;
+        ba->free_lists.clear();
+        for (size_t i = 0; ok && i < n; i++) ba->free_lists[flat[i].size].push_back(flat[i]);
+    } else if (ok) {
+        for (unsigned k = ba->min_shift; ok && k <= ba->top_order; k++)
+            ok = img.readExact("buddy.bits." + std::to_string(k), ba->order_bits[k].data(), ba->order_bits[k].size());
+        ok = ok && img.readExact("buddy.next", ba->fifo_next.data(), ba->fifo_next.size()) &&
+             img.readExact("buddy.prev", ba->fifo_prev.data(), ba->fifo_prev.size()) &&
+             img.readExact("buddy.head", ba->fifo_head, 64) && img.readExact("buddy.tail", ba->fifo_tail, 64);
+    }
+    if (ok) {
+        ba->next_id = h.next_id;
+        ba->alloc_success = h.alloc_success;
+        ba->alloc_fail = h.alloc_fail;
+        ba->used_mem = h.used_mem;
+        ba->total_splits = h.total_splits;
+        ba->total_merges = h.total_merges;
+        ba->order_mask = h.order_mask;
+        ok = ba->consistent();
+    }
+    if (!ok) {
+        delete ba;
+        err = "buddy image is inconsistent";
+        return nullptr;
+    }
+    return ba;
+}
+
+// Checks everything a later allocate/free follows: live and free blocks
+// must be power-of-two sized, size-aligned and tile the heap exactly, and
+// for the bitmap engine every FIFO list must be well linked, hold only
+// blocks of its order whose bits are set, and account for every set bit.
+bool BuddyAllocator::consistent() const {
+    std::vector<std::pair<uint64_t, uint64_t>> extents;
+    auto block_ok = [&](uint64_t start, uint64_t size) {
+        return size >= min_block && size <= memory_size && !(size & (size - 1)) && !(start & (size - 1)) &&
+               start < memory_size;
+    };
+    uint64_t used = 0;
+    for (size_t i = 1; i < allocated_blocks.size(); i++) {
+        const BuddyBlock &b = allocated_blocks[i];
+        if (!b.size) continue;
+        if (!block_ok(b.start, b.size) || b.id != (int)i) return false;
+        extents.push_back({b.start, b.size});
+        used += b.size;
+    }
+    if (used != used_mem) return false;
+
+    if (engine == BuddyEngine::FREE_LIST) {
+        for (const auto &entry : free_lists)
+            for (const BuddyBlock &b : entry.second) {
+                if (b.size != entry.first || !block_ok(b.start, b.size)) return false;
+                extents.push_back({b.start, b.size});
+            }
+    } else {
+        for (unsigned k = 0; k < 64; k++) {
+            bool in_use = k >= min_shift && k <= top_order;
+            bool listed = fifo_head[k] != NIL;
+            if (((order_mask >> k) & 1) != listed || (!in_use && (listed || fifo_tail[k] != NIL))) return false;
+            if (!in_use) continue;
+            uint64_t set = 0;
+            for (uint64_t w : order_bits[k]) set += __builtin_popcountll(w);
+            uint64_t walked = 0;
+            uint32_t prev = NIL;
+            for (uint32_t slot = fifo_head[k]; slot != NIL; slot = fifo_next[slot]) {
+                uint64_t addr = (uint64_t)slot << min_shift;
+                if (slot >= fifo_next.size() || ++walked > set || fifo_prev[slot] != prev ||
+                    !block_ok(addr, (uint64_t)1 << k) || !isFree(addr, k))
+                    return false;
+                extents.push_back({addr, (uint64_t)1 << k});
+                prev = slot;
+            }
+            if (prev != fifo_tail[k] || walked != set) return false;
+        }
+    }
+
+    std::sort(extents.begin(), extents.end());
+    uint64_t end = 0;
+    for (const auto &e : extents) {
+        if (e.first != end) return false;
+        end += e.second;
+    }
+    return end == memory_size;
 }
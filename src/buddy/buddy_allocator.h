@@ -5,6 +5,11 @@
 #include <cstdint>
 #include <cmath>
 #include <iostream>
+#include <string>
+#include <vector>
+
+class ImageWriter;
+class ImageFile;
 
 struct BuddyBlock {
     uint64_t start;
@@ -14,23 +19,104 @@ struct BuddyBlock {
     BuddyBlock() = default;
 };
 
+struct BuddyStats {
+    size_t total = 0;
+    size_t used = 0;
+    size_t free = 0;
+    size_t largest_free = 0;
+    uint64_t alloc_success = 0;
+    uint64_t alloc_fail = 0;
+    uint64_t splits = 0;
+    uint64_t merges = 0;
+
+    double utilization() const { return total ? (double)used / total * 100.0 : 0.0; }
+    uint64_t requests() const { return alloc_success + alloc_fail; }
+};
+
+// Outcome of one allocate/freeBlock call. id is -1 on failure; order is
+// log2 of the block size.
+struct BuddyResult {
+    int id = -1;
+    uint64_t address = 0;
+    unsigned order = 0;
+    unsigned splits = 0;
+    unsigned merges = 0;
+
+    bool ok() const { return id != -1; }
+};
+
+// FREE_LIST keeps a std::list per block size and scans it for the buddy on
+// every merge. BITMAP keeps one bit per (order, position) plus intrusive FIFO
+// links in flat arrays, so allocate/free are O(log N) with no node
+// allocation; both engines hand out identical addresses for the same trace.
+enum class BuddyEngine {
+    FREE_LIST,
+    BITMAP
+};
+
 class BuddyAllocator {
 public:
-    BuddyAllocator(size_t total_size);
-    int allocate(uint64_t request_size);
-    bool freeBlock(int block_id);
+    BuddyAllocator(size_t total_size, BuddyEngine engine = BuddyEngine::FREE_LIST, size_t min_block = 1);
+    BuddyResult allocate(uint64_t request_size);
+    BuddyResult freeBlock(int block_id);
     void dump() const;
     void stats() const;
+    BuddyStats snapshot() const;
+
+    BuddyEngine getEngine() const { return engine; }
+    // Address and block size of a live allocation; false for unknown or freed ids.
+    bool blockExtent(int block_id, uint64_t &start, uint64_t &size) const {
+        if (block_id <= 0 || (uint64_t)block_id >= next_id || allocated_blocks[block_id].size == 0) return false;
+        start = allocated_blocks[block_id].start;
+        size = allocated_blocks[block_id].size;
+        return true;
+    }
+    uint64_t minBlock() const { return min_block; }
+
+    // Snapshot image sections ("buddy.*"); loadImage returns nullptr and
+    // sets `err` when the image has no buddy heap or it does not fit.
+    void saveImage(ImageWriter &img) const;
+    static BuddyAllocator *loadImage(const ImageFile &img, std::string &err);
 
 private:
     size_t memory_size;
     size_t total_memory;      
+    BuddyEngine engine;
+    uint64_t min_block;
     uint64_t next_id = 1;    
-    int alloc_success = 0;
-    int alloc_fail = 0;
+    uint64_t alloc_success = 0;
+    uint64_t alloc_fail = 0;
+    size_t used_mem = 0;
+    uint64_t total_splits = 0;
+    uint64_t total_merges = 0;
+    // id -> allocated block (size 0 once freed); ids are dense and monotonic.
+    std::vector<BuddyBlock> allocated_blocks;
+
+    // FREE_LIST engine
     std::map<size_t, std::list<BuddyBlock>> free_lists;
-    std::map<int, BuddyBlock> allocated_blocks;
+
+    // BITMAP engine. Orders are log2(block size); a free block of order k at
+    // `addr` sets bit (addr >> k) of order_bits[k] and is linked, in FIFO
+    // order, through fifo_next/fifo_prev at slot addr / min_block.
+    static constexpr uint32_t NIL = UINT32_MAX;
+    unsigned min_shift = 0;
+    unsigned top_order = 0;
+    uint64_t order_mask = 0;
+    std::vector<std::vector<uint64_t>> order_bits;
+    std::vector<uint32_t> fifo_next, fifo_prev;
+    uint32_t fifo_head[64], fifo_tail[64];
 
     uint64_t nextPowerOf2(uint64_t n);
     uint64_t getBuddy(uint64_t addr, uint64_t size);
+
+    bool allocateList(uint64_t actual_size, BuddyResult &res);
+    void releaseList(BuddyBlock block, BuddyResult &res);
+    bool allocateBitmap(uint64_t actual_size, BuddyResult &res);
+    void releaseBitmap(BuddyBlock block, BuddyResult &res);
+
+    bool consistent() const;
+
+    bool isFree(uint64_t addr, unsigned order) const;
+    void pushFree(uint64_t addr, unsigned order);
+    void unlinkFree(uint64_t addr, unsigned order);
 };
@@ -1,51 +1,254 @@
 #include "cache.h"
+#include "../profile/profile.h"
+#include "../snapshot/snapshot.h"
 #include <iostream>
 #include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+const char *policy_name(CachePolicy p) {
+    switch (p) {
+    case CachePolicy::FIFO: return "FIFO";
+    case CachePolicy::LRU: return "LRU";
+    case CachePolicy::LFU: return "LFU";
+    case CachePolicy::PLRU: return "PLRU";
+    case CachePolicy::SRRIP: return "SRRIP";
+    }
+    return "?";
+}
+
+bool parse_policy(const std::string &name, CachePolicy &out) {
+    if (name == "fifo") out = CachePolicy::FIFO;
+    else if (name == "lru") out = CachePolicy::LRU;
+    else if (name == "lfu") out = CachePolicy::LFU;
+    else if (name == "plru") out = CachePolicy::PLRU;
+    else if (name == "srrip") out = CachePolicy::SRRIP;
+    else return false;
+    return true;
+}
+
+size_t Cache::setsFor(size_t cache_size, size_t block_size, size_t assoc) {
+    if (assoc == 0) assoc = 1;
+    if (assoc > MAX_WAYS) assoc = MAX_WAYS;
+    size_t sets = cache_size / (block_size * assoc);
+    return sets ? sets : 1;
+}
 
 Cache::Cache(size_t cache_size, size_t block_size, size_t assoc, CachePolicy policy)
     : size(cache_size), block(block_size), associativity(assoc), replacement_policy(policy) {
 
-    num_sets = size / (block * associativity);
-    if (num_sets == 0) num_sets = 1;
-    sets.resize(num_sets, std::vector<CacheLine>(associativity));
+    if (associativity == 0) associativity = 1;
+    if (associativity > MAX_WAYS) {
+        std::cout << "Associativity above " << MAX_WAYS << " ways is not supported; using " << MAX_WAYS << "\n";
+        associativity = MAX_WAYS;
+    }
+    if (replacement_policy == CachePolicy::PLRU && (associativity & (associativity - 1)) != 0) {
+        std::cout << "PLRU needs power-of-two associativity; using LRU\n";
+        replacement_policy = CachePolicy::LRU;
+    }
+    num_sets = setsFor(size, block, associativity);
+
+    pow2 = (block & (block - 1)) == 0 && (num_sets & (num_sets - 1)) == 0;
+    if (pow2) {
+        block_shift = __builtin_ctzll(block);
+        set_mask = num_sets - 1;
+    }
+
+    tags.assign(num_sets * associativity, 0);
+    valid.assign(num_sets, 0);
+    freq.assign(num_sets * associativity, 0);
+    dirty.assign(num_sets, 0);
+
+    switch (replacement_policy) {
+    case CachePolicy::FIFO: fifo.init(num_sets, associativity); bind<CachePolicy::FIFO>(); break;
+    case CachePolicy::LRU: lru.init(num_sets, associativity); bind<CachePolicy::LRU>(); break;
+    case CachePolicy::LFU: lfu.init(num_sets, associativity); bind<CachePolicy::LFU>(); break;
+    case CachePolicy::PLRU: plru.init(num_sets, associativity); bind<CachePolicy::PLRU>(); break;
+    case CachePolicy::SRRIP: srrip.init(num_sets, associativity); bind<CachePolicy::SRRIP>(); break;
+    }
+}
+
+template <CachePolicy P>
+void Cache::bind() {
+    lookup_fn = &Cache::lookup_impl<P>;
+    fill_fn = &Cache::fill_impl<P>;
+    invalidate_fn = &Cache::invalidate_impl<P>;
+}
+
+void Cache::setMissClassification(bool on) {
+    if (!on) classifier.reset();
+    else if (!classifier) classifier.emplace(num_sets * associativity);
 }
 
-bool Cache::access(uint64_t address, uint64_t &time) {
-    uint64_t tag = address / block;
-    uint64_t set = tag % num_sets;
+template <> Replacer<CachePolicy::FIFO> &Cache::replacer<CachePolicy::FIFO>() { return fifo; }
+template <> Replacer<CachePolicy::LRU> &Cache::replacer<CachePolicy::LRU>() { return lru; }
+template <> Replacer<CachePolicy::LFU> &Cache::replacer<CachePolicy::LFU>() { return lfu; }
+template <> Replacer<CachePolicy::PLRU> &Cache::replacer<CachePolicy::PLRU>() { return plru; }
+template <> Replacer<CachePolicy::SRRIP> &Cache::replacer<CachePolicy::SRRIP>() { return srrip; }
 
-    for (auto &line : sets[set]) {
-        if (line.valid && line.tag == tag) {
-            line.freq++;     
-            line.last_used = time;
-            return true;
+// Visits the state arrays of the replacer the cache was built with.
+template <typename Self, typename F>
+void Cache::replacer_state(Self &cache, F &&f) {
+    switch (cache.replacement_policy) {
+    case CachePolicy::FIFO: Replacer<CachePolicy::FIFO>::state(cache.fifo, f); break;
+    case CachePolicy::LRU: Replacer<CachePolicy::LRU>::state(cache.lru, f); break;
+    case CachePolicy::LFU: Replacer<CachePolicy::LFU>::state(cache.lfu, f); break;
+    case CachePolicy::PLRU: Replacer<CachePolicy::PLRU>::state(cache.plru, f); break;
+    case CachePolicy::SRRIP: Replacer<CachePolicy::SRRIP>::state(cache.srrip, f); break;
+    }
+}
+
+void Cache::saveImage(ImageWriter &img, const std::string &prefix) const {
+    img.add(prefix + "tags", tags);
+    img.add(prefix + "valid", valid);
+    img.add(prefix + "dirty", dirty);
+    img.add(prefix + "freq", freq);
+    img.addValue(prefix + "count", count);
+    img.addValue(prefix + "classify", (uint32_t)classifier.has_value());
+    size_t i = 0;
+    replacer_state(*this, [&](const auto &v) { img.add(prefix + "r" + std::to_string(i++), v); });
+}
+
+bool Cache::loadImage(const ImageFile &img, const std::string &prefix) {
+    bool ok = img.readExact(prefix + "tags", tags.data(), tags.size()) &&
+              img.readExact(prefix + "valid", valid.data(), valid.size()) &&
+              img.readExact(prefix + "dirty", dirty.data(), dirty.size()) &&
+              img.readExact(prefix + "freq", freq.data(), freq.size()) && img.readValue(prefix + "count", count);
+    uint32_t classify = 0;
+    ok = ok && img.readValue(prefix + "classify", classify);
+    size_t i = 0;
+    replacer_state(*this, [&](auto &v) { ok = ok && img.readExact(prefix + "r" + std::to_string(i++), v.data(), v.size()); });
+    uint64_t full = associativity == 64 ? ~0ULL : (1ULL << associativity) - 1;
+    for (size_t s = 0; ok && s < num_sets; s++) ok = !(valid[s] & ~full) && !(dirty[s] & ~valid[s]);
+    if (ok) {
+        switch (replacement_policy) {
+        case CachePolicy::FIFO: ok = fifo.check(valid); break;
+        case CachePolicy::LRU: ok = lru.check(valid); break;
+        case CachePolicy::LFU: ok = lfu.check(valid); break;
+        case CachePolicy::PLRU: ok = plru.check(valid); break;
+        case CachePolicy::SRRIP: ok = srrip.check(valid); break;
         }
     }
+    // The shadow is not in the image, so a classifying cache starts it empty.
+    classifier.reset();
+    if (ok) setMissClassification(classify != 0);
+    return ok;
+}
 
-    auto &lines = sets[set];
-    auto victim = std::min_element(lines.begin(), lines.end(),
-        [](const CacheLine &a, const CacheLine &b) {
-            if (!a.valid) return true;  
-            if (!b.valid) return false;
-            return a.freq < b.freq;    
-        });
+// Bit w of the result is set when way w holds `tag` (valid or not).
+uint64_t Cache::match_ways(const uint64_t *set_tags, uint64_t tag) const {
+    uint64_t match = 0;
+    size_t w = 0;
+#if defined(__AVX2__)
+    __m256i needle = _mm256_set1_epi64x((long long)tag);
+    for (; w + 4 <= associativity; w += 4) {
+        __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(set_tags + w));
+        int bits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lanes, needle)));
+        match |= (uint64_t)bits << w;
+    }
+#endif
+    for (; w < associativity; w++)
+        match |= (uint64_t)(set_tags[w] == tag) << w;
+    return match;
+}
+
+template <CachePolicy P>
+bool Cache::lookup_impl(uint64_t address, bool write) {
+    uint64_t tag, set;
+    locate(address, tag, set);
+    MEMSIM_PROFILE_COUNT(ProfCounter::WAYS_PROBED, __builtin_popcountll(valid[set]));
 
-    // Replace victim
-    victim->valid = true;
-    victim->tag = tag;
-    victim->freq = 1;    
-    victim->last_used = time;
+    uint64_t hit = find(set, tag);
+    if (hit) {
+        size_t way = __builtin_ctzll(hit);
+        freq[set * associativity + way]++;
+        if (write) dirty[set] |= hit;
+        replacer<P>().touch(set, way);
+        count.hits++;
+        if (classifier) classifier->observe_hit(tag);
+        return true;
+    }
 
+    count.misses++;
+    if (classifier) {
+        switch (classifier->observe_miss(tag)) {
+        case MissKind::COMPULSORY: count.compulsory++; break;
+        case MissKind::CAPACITY: count.capacity++; break;
+        case MissKind::CONFLICT: count.conflict++; break;
+        }
+    }
     return false;
 }
 
+template <CachePolicy P>
+CacheVictim Cache::fill_impl(uint64_t address, bool make_dirty) {
+    uint64_t tag, set;
+    locate(address, tag, set);
+    Replacer<P> &repl = replacer<P>();
+    size_t base = set * associativity;
+    CacheVictim out;
+
+    // Fill the lowest invalid way; only a full set consults the policy.
+    uint64_t full = associativity == 64 ? ~0ULL : (1ULL << associativity) - 1;
+    uint64_t empty = ~valid[set] & full;
+    size_t way;
+    if (empty) {
+        way = __builtin_ctzll(empty);
+    } else {
+        way = repl.victim(set);
+        out.valid = true;
+        out.address = tags[base + way] * block;
+        out.dirty = (dirty[set] >> way) & 1;
+        count.evictions++;
+        if (out.dirty) count.writebacks++;
+    }
+
+    uint64_t bit = 1ULL << way;
+    valid[set] |= bit;
+    if (make_dirty) dirty[set] |= bit; else dirty[set] &= ~bit;
+    tags[base + way] = tag;
+    freq[base + way] = 1;
+    repl.insert(set, way);
+    return out;
+}
+
+template <CachePolicy P>
+bool Cache::invalidate_impl(uint64_t address, bool &was_dirty) {
+    uint64_t tag, set;
+    locate(address, tag, set);
+    uint64_t hit = find(set, tag);
+    was_dirty = (dirty[set] & hit) != 0;
+    if (!hit) return false;
+
+    valid[set] &= ~hit;
+    dirty[set] &= ~hit;
+    replacer<P>().remove(set, __builtin_ctzll(hit));
+    return true;
+}
+
+bool Cache::markDirty(uint64_t address) {
+    uint64_t tag, set;
+    locate(address, tag, set);
+    uint64_t hit = find(set, tag);
+    dirty[set] |= hit;
+    return hit != 0;
+}
+
+bool Cache::contains(uint64_t address) const {
+    uint64_t tag, set;
+    locate(address, tag, set);
+    return find(set, tag) != 0;
+}
+
 void Cache::dump() const {
-    std::cout << "\n=== CACHE DUMP (LFU victim selection active) ===\n";
+    std::cout << "\n=== CACHE DUMP (" << policy_name(replacement_policy) << " replacement) ===\n";
     for (size_t i = 0; i < num_sets; i++) {
         std::cout << "Set " << i << ": ";
-        for (const auto &line : sets[i]) {
-            if (line.valid)
-                std::cout << "V(tag=" << line.tag << ", f=" << line.freq << ") ";
+        for (size_t w = 0; w < associativity; w++) {
+            size_t line = i * associativity + w;
+            if ((valid[i] >> w) & 1)
+                std::cout << ((dirty[i] >> w) & 1 ? "D" : "V") << "(tag=" << tags[line] << ", f=" << freq[line] << ") ";
             else
                 std::cout << "I ";
         }
@@ -54,23 +257,12 @@ void Cache::dump() const {
 }
 
 void Cache::stats() const {
-    size_t total_accesses = 0;
-    size_t hit_count = 0;
-
-    for (const auto &set : sets) {
-        for (const auto &line : set) {
-            if (line.valid) {
-                total_accesses += line.freq;
-                if (line.freq > 1) hit_count += (line.freq - 1);
-            }
-        }
-    }
-
-    double hit_ratio = total_accesses ? (double)hit_count / total_accesses * 100.0 : 0.0;
-
-    std::cout << "\n=== CACHE STATS (LFU) ===\n";
-    std::cout << "Total accesses: " << total_accesses << "\n";
-    std::cout << "Cache hits: " << hit_count << "\n";
-    std::cout << "Hit ratio: " << std::fixed << hit_ratio << "%\n";
+    std::cout << "\n=== CACHE STATS (" << policy_name(replacement_policy) << ") ===\n";
+    std::cout << "Total accesses: " << count.accesses() << "\n";
+    std::cout << "Cache hits: " << count.hits << "  misses: " << count.misses << "\n";
+    std::cout << "Hit ratio: " << std::fixed << count.hit_ratio() << "%\n";
+    std::cout << "Evictions: " << count.evictions << "  writebacks: " << count.writebacks << "\n";
+    if (classifier)
+        std::cout << "Misses: compulsory " << count.compulsory << "  capacity " << count.capacity
+                  << "  conflict " << count.conflict << "\n";
 }
-
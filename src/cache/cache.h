@@ -1,32 +1,145 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <string>
 #include <vector>
+#include "miss_classifier.h"
+#include "replacement.h"
 
-struct CacheLine {
-    bool valid = false;
-    uint64_t tag = 0;
-    int freq = 0;          
-    uint64_t last_used = 0; 
+class ImageWriter;
+class ImageFile;
+
+struct CacheCounters {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t writebacks = 0;   // dirty lines evicted
+    // 3C breakdown of `misses`, when classification is enabled
+    uint64_t compulsory = 0;
+    uint64_t capacity = 0;
+    uint64_t conflict = 0;
+
+    CacheCounters &operator+=(const CacheCounters &o) {
+        hits += o.hits;
+        misses += o.misses;
+        evictions += o.evictions;
+        writebacks += o.writebacks;
+        compulsory += o.compulsory;
+        capacity += o.capacity;
+        conflict += o.conflict;
+        return *this;
+    }
+
+    uint64_t accesses() const { return hits + misses; }
+    double hit_ratio() const { return accesses() ? (double)hits / accesses() * 100.0 : 0.0; }
 };
 
-enum class CachePolicy {
-    FIFO,
-    LRU,
-    LFU  
+// Block displaced by Cache::fill().
+struct CacheVictim {
+    bool valid = false;
+    uint64_t address = 0;
+    bool dirty = false;
 };
 
+// Set-associative cache stored as flat structure-of-arrays: line `w` of set
+// `s` lives at index s * associativity + w in every per-line array, and each
+// set keeps its valid bits in one 64-bit mask. With power-of-two block size
+// and set count, indexing is a shift and a mask.
+//
+// The replacement policy is fixed at construction: the public operations
+// jump through member pointers to *_impl<P>, compiled once per policy.
+//
+// access() is the standalone path (look up, fill on miss). A hierarchy uses
+// the finer operations: lookup() counts a hit or miss without filling,
+// fill() installs a block and reports what it displaced, and invalidate()/
+// markDirty() update a line without counting an access.
 class Cache {
 public:
+    static constexpr size_t MAX_WAYS = 64;
+
     Cache(size_t cache_size, size_t block_size, size_t assoc, CachePolicy policy);
-    bool access(uint64_t address, uint64_t &time);
+
+    // Number of sets the constructor derives from a geometry.
+    static size_t setsFor(size_t cache_size, size_t block_size, size_t assoc);
+
+    bool access(uint64_t address, bool write = false) {
+        if ((this->*lookup_fn)(address, write)) return true;
+        (this->*fill_fn)(address, write);
+        return false;
+    }
+    bool lookup(uint64_t address, bool write) { return (this->*lookup_fn)(address, write); }
+    CacheVictim fill(uint64_t address, bool dirty) { return (this->*fill_fn)(address, dirty); }
+    bool invalidate(uint64_t address, bool &was_dirty) { return (this->*invalidate_fn)(address, was_dirty); }
+    bool markDirty(uint64_t address);
+    bool contains(uint64_t address) const;
+
+    size_t blockSize() const { return block; }
+    CachePolicy policy() const { return replacement_policy; }
     void dump() const;
     void stats() const;
 
+    const CacheCounters &counters() const { return count; }
+
+    // Lines, counters and the replacement state as image sections named
+    // prefix + "tags", ...; loading needs a cache of the same geometry and
+    // policy. The 3C shadow is not saved and restarts empty.
+    void saveImage(ImageWriter &img, const std::string &prefix) const;
+    bool loadImage(const ImageFile &img, const std::string &prefix);
+    // 3C classification keeps a fully associative shadow of equal size and
+    // a seen-block set, a hash lookup or two on every access; it is off
+    // unless turned on.
+    void setMissClassification(bool on);
+    bool classifiesMisses() const { return classifier.has_value(); }
+
 private:
     size_t size;
     size_t block;
     size_t associativity;
     size_t num_sets;
     CachePolicy replacement_policy;
-    std::vector<std::vector<CacheLine>> sets;
+
+    bool pow2 = false;
+    unsigned block_shift = 0;
+    uint64_t set_mask = 0;
+
+    std::vector<uint64_t> tags;
+    std::vector<uint64_t> valid;
+    std::vector<uint64_t> dirty;
+    std::vector<uint32_t> freq;   // references to the resident line
+
+    CacheCounters count;
+    std::optional<MissClassifier> classifier;
+
+    Replacer<CachePolicy::FIFO> fifo;
+    Replacer<CachePolicy::LRU> lru;
+    Replacer<CachePolicy::LFU> lfu;
+    Replacer<CachePolicy::PLRU> plru;
+    Replacer<CachePolicy::SRRIP> srrip;
+
+    bool (Cache::*lookup_fn)(uint64_t, bool);
+    CacheVictim (Cache::*fill_fn)(uint64_t, bool);
+    bool (Cache::*invalidate_fn)(uint64_t, bool &);
+
+    template <CachePolicy P> Replacer<P> &replacer();
+    template <typename Self, typename F> static void replacer_state(Self &cache, F &&f);
+    template <CachePolicy P> void bind();
+    template <CachePolicy P> bool lookup_impl(uint64_t address, bool write);
+    template <CachePolicy P> CacheVictim fill_impl(uint64_t address, bool dirty);
+    template <CachePolicy P> bool invalidate_impl(uint64_t address, bool &was_dirty);
+
+    void locate(uint64_t address, uint64_t &tag, uint64_t &set) const {
+        if (pow2) {
+            tag = address >> block_shift;
+            set = tag & set_mask;
+        } else {
+            tag = address / block;
+            set = tag % num_sets;
+        }
+    }
+    // Valid way holding `tag` in `set` as a one-hot mask, or 0.
+    uint64_t find(uint64_t set, uint64_t tag) const {
+        return match_ways(&tags[set * associativity], tag) & valid[set];
+    }
+    uint64_t match_ways(const uint64_t *set_tags, uint64_t tag) const;
 };
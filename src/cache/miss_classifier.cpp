@@ -0,0 +1,53 @@
+#include "miss_classifier.h"
+
+MissClassifier::MissClassifier(size_t lines) : capacity(lines ? lines : 1) {
+    slot_block.reserve(capacity);
+    prev.reserve(capacity);
+    next.reserve(capacity);
+    where.reserve(capacity);
+}
+
+void MissClassifier::unlink(uint32_t s) {
+    if (prev[s] != NIL) next[prev[s]] = next[s]; else head = next[s];
+    if (next[s] != NIL) prev[next[s]] = prev[s]; else tail = prev[s];
+}
+
+void MissClassifier::push_front(uint32_t s) {
+    prev[s] = NIL;
+    next[s] = head;
+    if (head != NIL) prev[head] = s; else tail = s;
+    head = s;
+}
+
+bool MissClassifier::shadow_access(uint64_t block) {
+    auto it = where.find(block);
+    if (it != where.end()) {
+        if (it->second != head) {
+            unlink(it->second);
+            push_front(it->second);
+        }
+        return true;
+    }
+
+    uint32_t s;
+    if (slot_block.size() < capacity) {
+        s = (uint32_t)slot_block.size();
+        slot_block.push_back(block);
+        prev.push_back(NIL);
+        next.push_back(NIL);
+    } else {
+        s = tail;
+        unlink(s);
+        where.erase(slot_block[s]);
+        slot_block[s] = block;
+    }
+    where.emplace(block, s);
+    push_front(s);
+    return false;
+}
+
+MissKind MissClassifier::observe_miss(uint64_t block) {
+    bool shadow_hit = shadow_access(block);
+    if (seen.insert(block).second) return MissKind::COMPULSORY;
+    return shadow_hit ? MissKind::CONFLICT : MissKind::CAPACITY;
+}
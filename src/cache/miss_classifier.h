@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+enum class MissKind {
+    COMPULSORY,  // first reference to the block
+    CAPACITY,    // would also miss in a fully associative LRU cache of equal size
+    CONFLICT     // hits in that fully associative cache, so the set mapping caused it
+};
+
+// 3C miss classifier. Sees every block reference of one cache level and
+// keeps a fully associative LRU shadow with the same number of lines.
+class MissClassifier {
+public:
+    explicit MissClassifier(size_t lines);
+
+    // Every reference of the level must go through one of these two calls
+    // so the shadow sees the same stream as the real cache.
+    void observe_hit(uint64_t block) { shadow_access(block); }
+    MissKind observe_miss(uint64_t block);
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    size_t capacity;
+    std::unordered_set<uint64_t> seen;
+    std::unordered_map<uint64_t, uint32_t> where;   // block -> shadow slot
+    std::vector<uint64_t> slot_block;
+    std::vector<uint32_t> prev, next;               // recency list, head = MRU
+    uint32_t head = NIL, tail = NIL;
+
+    void unlink(uint32_t s);
+    void push_front(uint32_t s);
+    bool shadow_access(uint64_t block);
+};
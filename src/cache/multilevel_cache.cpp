@@ -1,40 +1,275 @@
 #include "multilevel_cache.h"
+#include "../profile/profile.h"
+#include "../snapshot/snapshot.h"
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 
-MultiLevelCache::MultiLevelCache(Cache l1, Cache l2)
-    : L1(l1), L2(l2) {}
+HierarchyConfig default_hierarchy() {
+    HierarchyConfig c;
+    c.levels.push_back({256, 64, 1, CachePolicy::FIFO});
+    c.levels.push_back({1024, 64, 4, CachePolicy::LRU});
+    return c;
+}
+
+bool parse_hierarchy_config(const std::vector<std::string> &tokens, HierarchyConfig &out, std::string &err) {
+    HierarchyConfig c;
+    for (const std::string &t : tokens) {
+        if (t == "inclusive") c.inclusion = InclusionPolicy::INCLUSIVE;
+        else if (t == "exclusive") c.inclusion = InclusionPolicy::EXCLUSIVE;
+        else if (t == "nine") c.inclusion = InclusionPolicy::NINE;
+        else if (t == "write_back") c.write_policy = WritePolicy::WRITE_BACK;
+        else if (t == "write_through") c.write_policy = WritePolicy::WRITE_THROUGH;
+        else if (t == "allocate") c.write_allocate = true;
+        else if (t == "no_allocate") c.write_allocate = false;
+        else {
+            std::istringstream ss(t);
+            CacheLevelConfig l;
+            char c1 = 0, c2 = 0, c3 = 0;
+            std::string policy;
+            if (!(ss >> l.size >> c1 >> l.block >> c2 >> l.assoc >> c3) || c1 != ':' || c2 != ':' || c3 != ':' ||
+                !(ss >> policy) || !parse_policy(policy, l.policy)) {
+                err = "bad level '" + t + "' (expected size:block:assoc:fifo|lru|lfu|plru|srrip)";
+                return false;
+            }
+            if (l.size == 0 || l.block == 0 || l.assoc == 0) {
+                err = "level sizes must be non-zero in '" + t + "'";
+                return false;
+            }
+            c.levels.push_back(l);
+        }
+    }
+    if (c.levels.empty()) {
+        err = "no cache levels given";
+        return false;
+    }
+    for (const CacheLevelConfig &l : c.levels)
+        if (l.block != c.levels[0].block) {
+            err = "all levels must use the same block size";
+            return false;
+        }
+    out = c;
+    return true;
+}
+
+MultiLevelCache::MultiLevelCache(const HierarchyConfig &config)
+    : cfg(config), inclusion(config.inclusion), write_policy(config.write_policy), write_allocate(config.write_allocate) {
+    levels.reserve(config.levels.size());
+    for (const CacheLevelConfig &l : config.levels)
+        levels.emplace_back(l.size, l.block, l.assoc, l.policy);
+}
+
+bool MultiLevelCache::access(uint64_t address, bool write) {
+    MEMSIM_PROFILE_SCOPE(ProfOp::CACHE_ACCESS);
+    bool write_back_l1 = write && write_policy == WritePolicy::WRITE_BACK;
+    if (write && write_policy == WritePolicy::WRITE_THROUGH) memory_writes++;
+
+    size_t n = levels.size();
+    size_t hit = 0;
+    while (hit < n && !levels[hit].lookup(address, hit == 0 && write_back_l1)) hit++;
+    if (hit == 0) return true;
+
+    if (write && !write_allocate) {
+        // The write bypasses the levels that missed.
+        if (write_back_l1) {
+            if (hit < n) levels[hit].markDirty(address);
+            else memory_writes++;
+        }
+        return hit < n;
+    }
+
+    bool dirty = false;
+    if (hit == n) {
+        memory_reads++;
+    } else if (inclusion == InclusionPolicy::EXCLUSIVE) {
+        levels[hit].invalidate(address, dirty);
+    }
+
+    if (inclusion == InclusionPolicy::EXCLUSIVE) {
+        install(0, address, dirty || write_back_l1);
+    } else {
+        // Fill from the bottom up so an inclusive back-invalidation can never
+        // remove the block that is being brought in.
+        for (size_t lvl = hit; lvl-- > 0;)
+            install(lvl, address, lvl == 0 && write_back_l1);
+    }
+    return hit < n;
+}
+
+void MultiLevelCache::install(size_t lvl, uint64_t address, bool dirty) {
+    CacheVictim v = levels[lvl].fill(address, dirty);
+    if (!v.valid) return;
+
+    if (inclusion == InclusionPolicy::EXCLUSIVE) {
+        if (lvl + 1 < levels.size()) install(lvl + 1, v.address, v.dirty);
+        else if (v.dirty) memory_writes++;
+        return;
+    }
+
+    if (inclusion == InclusionPolicy::INCLUSIVE) {
+        for (size_t up = 0; up < lvl; up++) {
+            bool up_dirty;
+            if (levels[up].invalidate(v.address, up_dirty)) {
+                back_invalidations++;
+                v.dirty |= up_dirty;
+            }
+        }
+    }
+    if (v.dirty) write_back(lvl + 1, v.address);
+}
+
+void MultiLevelCache::write_back(size_t lvl, uint64_t address) {
+    if (lvl == levels.size()) {
+        memory_writes++;
+        return;
+    }
+    if (!levels[lvl].markDirty(address)) install(lvl, address, true);
+}
+
+namespace {
+
+struct LevelImage {
+    uint64_t size;
+    uint64_t block;
+    uint64_t assoc;
+    uint32_t policy;
+    uint32_t pad;
+};
+
+struct HierarchyImage {
+    uint32_t inclusion;
+    uint32_t write_policy;
+    uint32_t write_allocate;
+    uint32_t pad;
+    uint64_t memory_reads;
+    uint64_t memory_writes;
+    uint64_t back_invalidations;
+};
+
+std::string level_prefix(size_t i) {
+    return "cache.L" + std::to_string(i + 1) + ".";
+}
 
-bool MultiLevelCache::access(uint64_t address) {
-    if (L1.access(address, time)) {
-        l1_hits++;
-        return true;
+}  // namespace
+
+void MultiLevelCache::saveImage(ImageWriter &img) const {
+    std::vector<LevelImage> geometry;
+    for (const CacheLevelConfig &l : cfg.levels) geometry.push_back({l.size, l.block, l.assoc, (uint32_t)l.policy, 0});
+    img.addCopy("cache.levels", geometry.data(), geometry.size() * sizeof(LevelImage));
+    HierarchyImage h{};
+    h.inclusion = (uint32_t)inclusion;
+    h.write_policy = (uint32_t)write_policy;
+    h.write_allocate = write_allocate;
+    h.memory_reads = memory_reads;
+    h.memory_writes = memory_writes;
+    h.back_invalidations = back_invalidations;
+    img.addValue("cache.state", h);
+    for (size_t i = 0; i < levels.size(); i++) levels[i].saveImage(img, level_prefix(i));
+}
+
+bool MultiLevelCache::loadImage(const ImageFile &img, std::string &err) {
+    size_t n = 0;
+    const LevelImage *geometry = img.view<LevelImage>("cache.levels", n);
+    HierarchyImage h;
+    if (!geometry || !n || !img.readValue("cache.state", h)) {
+        err = "image has no cache hierarchy";
+        return false;
     }
+    HierarchyConfig config;
+    bool ok = h.inclusion <= (uint32_t)InclusionPolicy::NINE && h.write_policy <= (uint32_t)WritePolicy::WRITE_THROUGH;
+    // The levels are only built once each one's line arrays in the image
+    // have the size its geometry implies.
+    for (size_t i = 0; ok && i < n; i++) {
+        const LevelImage &l = geometry[i];
+        size_t ways = std::min<size_t>(std::max<size_t>(l.assoc, 1), Cache::MAX_WAYS), lines = 0;
+        ok = l.policy <= (uint32_t)CachePolicy::SRRIP && l.block && l.block <= UINT64_MAX / Cache::MAX_WAYS && l.size &&
+             img.view<uint64_t>(level_prefix(i) + "tags", lines) &&
+             lines == Cache::setsFor(l.size, l.block, l.assoc) * ways;
+        config.levels.push_back({l.size, l.block, l.assoc, (CachePolicy)l.policy});
+    }
+    if (!ok) {
+        err = "cache image is inconsistent";
+        return false;
+    }
+    config.inclusion = (InclusionPolicy)h.inclusion;
+    config.write_policy = (WritePolicy)h.write_policy;
+    config.write_allocate = h.write_allocate != 0;
 
-    l1_misses++;
-    if (L2.access(address, time)) {
-        l2_hits++;
-        return true;
+    MultiLevelCache restored(config);
+    for (size_t i = 0; ok && i < n; i++) ok = restored.levels[i].loadImage(img, level_prefix(i));
+    if (!ok) {
+        err = "cache image does not match its geometry";
+        return false;
     }
+    restored.memory_reads = h.memory_reads;
+    restored.memory_writes = h.memory_writes;
+    restored.back_invalidations = h.back_invalidations;
+    *this = std::move(restored);
+    return true;
+}
 
-    l2_misses++;
-    time++;
-    return false;
+void MultiLevelCache::setMissClassification(bool on) {
+    for (Cache &c : levels) c.setMissClassification(on);
+}
+
+static const char *inclusion_name(InclusionPolicy p) {
+    switch (p) {
+    case InclusionPolicy::INCLUSIVE: return "inclusive";
+    case InclusionPolicy::EXCLUSIVE: return "exclusive";
+    case InclusionPolicy::NINE: return "non-inclusive";
+    }
+    return "?";
 }
 
 void MultiLevelCache::dump() const {
     std::cout << "\n=== MULTILEVEL CACHE DUMP ===\n";
-    L1.dump();
-    L2.dump();
+    std::cout << levels.size() << " levels, " << inclusion_name(inclusion) << ", "
+              << (write_policy == WritePolicy::WRITE_BACK ? "write-back" : "write-through") << ", "
+              << (write_allocate ? "write-allocate" : "no-write-allocate") << "\n";
+    for (const Cache &c : levels) c.dump();
 }
 
-void MultiLevelCache::stats() const {
-    int total_L1 = l1_hits + l1_misses;
-    int total_L2 = l2_hits + l2_misses;
+HierarchyCounters &HierarchyCounters::operator+=(const HierarchyCounters &o) {
+    if (levels.size() < o.levels.size()) levels.resize(o.levels.size());
+    for (size_t i = 0; i < o.levels.size(); i++) levels[i] += o.levels[i];
+    memory_reads += o.memory_reads;
+    memory_writes += o.memory_writes;
+    back_invalidations += o.back_invalidations;
+    return *this;
+}
+
+HierarchyCounters MultiLevelCache::counters() const {
+    HierarchyCounters c;
+    for (const Cache &l : levels) c.levels.push_back(l.counters());
+    c.memory_reads = memory_reads;
+    c.memory_writes = memory_writes;
+    c.back_invalidations = back_invalidations;
+    return c;
+}
 
+void print_hierarchy_stats(const HierarchyCounters &c, InclusionPolicy inclusion, bool classified) {
     std::cout << "\n=== MULTILEVEL CACHE STATS ===\n";
-    std::cout << "L1 hits: " << l1_hits << "  L1 misses: " << l1_misses << "\n";
-    std::cout << "L2 hits: " << l2_hits << "  L2 misses: " << l2_misses << "\n";
+    for (size_t i = 0; i < c.levels.size(); i++) {
+        std::string name = "L" + std::to_string(i + 1);
+        std::cout << name << " hits: " << c.levels[i].hits << "  " << name << " misses: " << c.levels[i].misses << "\n";
+    }
+    for (size_t i = 0; i < c.levels.size(); i++)
+        std::cout << "L" << i + 1 << " hit ratio: " << c.levels[i].hit_ratio() << "%\n";
+    for (size_t i = 0; i < c.levels.size(); i++) {
+        const CacheCounters &n = c.levels[i];
+        std::string name = "L" + std::to_string(i + 1);
+        std::cout << name << " evictions: " << n.evictions << "  writebacks: " << n.writebacks << "\n";
+        if (classified)
+            std::cout << name << " misses: compulsory " << n.compulsory << "  capacity " << n.capacity
+                      << "  conflict " << n.conflict << "\n";
+    }
 
-    std::cout << "L1 hit ratio: " << (total_L1 ? (double)l1_hits/total_L1*100.0 : 0.0) << "%\n";
-    std::cout << "L2 hit ratio: " << (total_L2 ? (double)l2_hits/total_L2*100.0 : 0.0) << "%\n";
+    std::cout << "Memory reads: " << c.memory_reads << "  Memory writes: " << c.memory_writes << "\n";
+    if (inclusion == InclusionPolicy::INCLUSIVE)
+        std::cout << "Back-invalidations: " << c.back_invalidations << "\n";
+}
+
+void MultiLevelCache::stats() const {
+    // Classification is toggled for the whole hierarchy at once.
+    print_hierarchy_stats(counters(), inclusion, levels[0].classifiesMisses());
 }
@@ -1,17 +1,87 @@
 #pragma once
 #include "cache.h"
 #include <cstdint>
+#include <string>
+#include <vector>
+
+// How the contents of adjacent levels relate:
+//   INCLUSIVE  every block in level i is also in level i+1; an eviction from
+//              a lower level back-invalidates the copies above it
+//   EXCLUSIVE  a block lives in exactly one level; hits below L1 move the
+//              block up and every eviction moves the victim one level down
+//   NINE       non-inclusive non-exclusive: fills go to every level that
+//              missed and evictions leave the other levels alone
+enum class InclusionPolicy { INCLUSIVE, EXCLUSIVE, NINE };
+enum class WritePolicy { WRITE_BACK, WRITE_THROUGH };
+
+struct CacheLevelConfig {
+    size_t size;
+    size_t block;
+    size_t assoc;
+    CachePolicy policy;
+};
+
+struct HierarchyConfig {
+    std::vector<CacheLevelConfig> levels;
+    InclusionPolicy inclusion = InclusionPolicy::NINE;
+    WritePolicy write_policy = WritePolicy::WRITE_BACK;
+    bool write_allocate = true;
+};
+
+// The hierarchy the simulator starts with: L1 256:64:1:fifo, L2 1024:64:4:lru.
+HierarchyConfig default_hierarchy();
+
+// Parses tokens of the form `size:block:assoc:policy` (one per level, L1
+// first) mixed with inclusive | exclusive | nine, write_back | write_through
+// and allocate | no_allocate. All levels must share one block size.
+bool parse_hierarchy_config(const std::vector<std::string> &tokens, HierarchyConfig &out, std::string &err);
+
+// Counters of a whole hierarchy; plain sums, so shards of one hierarchy can
+// be merged with +=.
+struct HierarchyCounters {
+    std::vector<CacheCounters> levels;
+    uint64_t memory_reads = 0;
+    uint64_t memory_writes = 0;
+    uint64_t back_invalidations = 0;
+
+    HierarchyCounters &operator+=(const HierarchyCounters &o);
+};
+
+// Prints the `cache stats` report. 3C lines are shown when `classified`.
+void print_hierarchy_stats(const HierarchyCounters &c, InclusionPolicy inclusion, bool classified);
 
 class MultiLevelCache {
 public:
-    MultiLevelCache(Cache l1, Cache l2);
-    bool access(uint64_t address);
+    explicit MultiLevelCache(const HierarchyConfig &config);
+    const HierarchyConfig &config() const { return cfg; }
+    // Returns true when some level hit.
+    bool access(uint64_t address, bool write = false);
     void dump() const;
     void stats() const;
+    void setMissClassification(bool on);
+
+    // Snapshot image sections ("cache.*"). Loading rebuilds the hierarchy
+    // from the image's own configuration; on failure *this is unchanged.
+    void saveImage(ImageWriter &img) const;
+    bool loadImage(const ImageFile &img, std::string &err);
+
+    size_t numLevels() const { return levels.size(); }
+    const Cache &level(size_t i) const { return levels[i]; }
+    uint64_t memoryReads() const { return memory_reads; }
+    uint64_t memoryWrites() const { return memory_writes; }
+    HierarchyCounters counters() const;
 
 private:
-    Cache L1, L2;
-    uint64_t time = 0;
-    int l1_hits = 0, l1_misses = 0;
-    int l2_hits = 0, l2_misses = 0;
+    HierarchyConfig cfg;
+    std::vector<Cache> levels;
+    InclusionPolicy inclusion;
+    WritePolicy write_policy;
+    bool write_allocate;
+
+    uint64_t memory_reads = 0;
+    uint64_t memory_writes = 0;
+    uint64_t back_invalidations = 0;
+
+    void install(size_t lvl, uint64_t address, bool dirty);
+    void write_back(size_t lvl, uint64_t address);
 };
@@ -0,0 +1,332 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class CachePolicy {
+    FIFO,
+    LRU,
+    LFU,
+    PLRU,   // tree pseudo-LRU, power-of-two associativity
+    SRRIP   // static re-reference interval prediction, 2-bit RRPV
+};
+
+const char *policy_name(CachePolicy p);
+// Lower-case policy name ("fifo", "lru", ...) as used on the command line.
+bool parse_policy(const std::string &name, CachePolicy &out);
+
+// Replacement state for one policy, specialised per CachePolicy. Each
+// Cache::lookup_impl<P> / fill_impl<P> instantiation calls its Replacer<P>
+// directly with no branch on the policy; the Cache reaches that instantiation
+// through a member pointer bound at construction, so every access costs one
+// indirect call.
+// Every specialisation provides:
+//   init(sets, ways)      size the state
+//   touch(set, way)       a hit on a valid line
+//   insert(set, way)      a line was just filled
+//   remove(set, way)      a line was invalidated
+//   victim(set)           way to evict from a full set (O(1) except SRRIP)
+//   state(r, f)           calls f on every state array of r (snapshots)
+//   check(valid)          state loaded from an image is well formed for
+//                         these per-set valid masks
+// The cache itself fills invalid ways before asking for a victim.
+template <CachePolicy P>
+struct Replacer;
+
+constexpr uint8_t NO_WAY = 0xff;
+
+// Per-set doubly linked recency list of ways: head is MRU, tail is LRU.
+template <>
+struct Replacer<CachePolicy::LRU> {
+    std::vector<uint8_t> prev, next, head, tail;
+    size_t ways = 0;
+
+    template <typename R, typename F> static void state(R &r, F &&f) {
+        f(r.prev);
+        f(r.next);
+        f(r.head);
+        f(r.tail);
+    }
+
+    // Every way is on its set's list exactly once.
+    bool check(const std::vector<uint64_t> &) const {
+        for (size_t set = 0; set < head.size(); set++) {
+            size_t base = set * ways, walked = 0;
+            uint8_t p = NO_WAY;
+            for (uint8_t w = head[set]; w != NO_WAY; w = next[base + w]) {
+                if (w >= ways || ++walked > ways || prev[base + w] != p) return false;
+                p = w;
+            }
+            if (walked != ways || p != tail[set]) return false;
+        }
+        return true;
+    }
+
+    void init(size_t sets, size_t w) {
+        ways = w;
+        prev.assign(sets * w, NO_WAY);
+        next.assign(sets * w, NO_WAY);
+        head.assign(sets, 0);
+        tail.assign(sets, (uint8_t)(w - 1));
+        for (size_t s = 0; s < sets; s++)
+            for (size_t i = 0; i < w; i++) {
+                prev[s * w + i] = i ? (uint8_t)(i - 1) : NO_WAY;
+                next[s * w + i] = i + 1 < w ? (uint8_t)(i + 1) : NO_WAY;
+            }
+    }
+
+    void unlink(size_t set, size_t way) {
+        size_t base = set * ways;
+        uint8_t p = prev[base + way], n = next[base + way];
+        if (p != NO_WAY) next[base + p] = n; else head[set] = n;
+        if (n != NO_WAY) prev[base + n] = p; else tail[set] = p;
+    }
+
+    void touch(size_t set, size_t way) {
+        if (head[set] == way) return;
+        size_t base = set * ways;
+        unlink(set, way);
+        prev[base + way] = NO_WAY;
+        next[base + way] = head[set];
+        prev[base + head[set]] = (uint8_t)way;
+        head[set] = (uint8_t)way;
+    }
+    void insert(size_t set, size_t way) { touch(set, way); }
+    void remove(size_t set, size_t way) {
+        if (tail[set] == way) return;
+        size_t base = set * ways;
+        unlink(set, way);
+        next[base + way] = NO_WAY;
+        prev[base + way] = tail[set];
+        next[base + tail[set]] = (uint8_t)way;
+        tail[set] = (uint8_t)way;
+    }
+    size_t victim(size_t set) { return tail[set]; }
+};
+
+// The LRU list ordered by fill instead of use: a fill moves the way to the
+// head, hits leave it alone, so the tail is the oldest resident line. An
+// invalidated way goes to the tail like in LRU and is refilled first.
+template <>
+struct Replacer<CachePolicy::FIFO> : Replacer<CachePolicy::LRU> {
+    void touch(size_t, size_t) {}
+    void insert(size_t set, size_t way) { Replacer<CachePolicy::LRU>::touch(set, way); }
+};
+
+// O(1) LFU: each set keeps a list of frequency buckets in ascending order,
+// and each bucket keeps its ways in recency order. The victim is the least
+// recently used way of the lowest-frequency bucket.
+template <>
+struct Replacer<CachePolicy::LFU> {
+    // per way
+    std::vector<uint32_t> freq;
+    std::vector<uint8_t> bucket, prev, next;
+    // per bucket slot (ways slots per set)
+    std::vector<uint32_t> b_freq;
+    std::vector<uint8_t> b_head, b_tail, b_prev, b_next;
+    // per set
+    std::vector<uint8_t> first, free_slot;
+    size_t ways = 0;
+
+    template <typename R, typename F> static void state(R &r, F &&f) {
+        f(r.freq);
+        f(r.bucket);
+        f(r.prev);
+        f(r.next);
+        f(r.b_freq);
+        f(r.b_head);
+        f(r.b_tail);
+        f(r.b_prev);
+        f(r.b_next);
+        f(r.first);
+        f(r.free_slot);
+    }
+
+    // Buckets run in ascending frequency and hold exactly the valid ways;
+    // the unused bucket slots make up the rest of the set's slots.
+    bool check(const std::vector<uint64_t> &valid) const {
+        for (size_t set = 0; set < first.size(); set++) {
+            size_t base = set * ways;
+            uint64_t listed = 0, slots = 0;
+            uint8_t bp = NO_WAY;
+            for (uint8_t b = first[set]; b != NO_WAY; b = b_next[base + b]) {
+                if (b >= ways || ((slots >> b) & 1) || b_prev[base + b] != bp || b_head[base + b] == NO_WAY ||
+                    (bp != NO_WAY && b_freq[base + b] <= b_freq[base + bp]))
+                    return false;
+                uint8_t p = NO_WAY;
+                for (uint8_t w = b_head[base + b]; w != NO_WAY; w = next[base + w]) {
+                    if (w >= ways || ((listed >> w) & 1) || bucket[base + w] != b || prev[base + w] != p ||
+                        freq[base + w] != b_freq[base + b])
+                        return false;
+                    listed |= 1ULL << w;
+                    p = w;
+                }
+                if (p != b_tail[base + b]) return false;
+                slots |= 1ULL << b;
+                bp = b;
+            }
+            for (uint8_t b = free_slot[set]; b != NO_WAY; b = b_next[base + b]) {
+                if (b >= ways || ((slots >> b) & 1)) return false;
+                slots |= 1ULL << b;
+            }
+            uint64_t all = ways == 64 ? ~0ULL : (1ULL << ways) - 1;
+            if (slots != all || listed != valid[set]) return false;
+        }
+        return true;
+    }
+
+    void init(size_t sets, size_t w) {
+        ways = w;
+        freq.assign(sets * w, 0);
+        bucket.assign(sets * w, NO_WAY);
+        prev.assign(sets * w, NO_WAY);
+        next.assign(sets * w, NO_WAY);
+        b_freq.assign(sets * w, 0);
+        b_head.assign(sets * w, NO_WAY);
+        b_tail.assign(sets * w, NO_WAY);
+        b_prev.assign(sets * w, NO_WAY);
+        b_next.assign(sets * w, NO_WAY);
+        first.assign(sets, NO_WAY);
+        free_slot.assign(sets, 0);
+        // Unused bucket slots form a stack threaded through b_next.
+        for (size_t s = 0; s < sets; s++)
+            for (size_t i = 0; i < w; i++)
+                b_next[s * w + i] = i + 1 < w ? (uint8_t)(i + 1) : NO_WAY;
+    }
+
+    uint8_t new_bucket(size_t set, uint32_t f, uint8_t after) {
+        size_t base = set * ways;
+        uint8_t b = free_slot[set];
+        free_slot[set] = b_next[base + b];
+        b_freq[base + b] = f;
+        b_head[base + b] = b_tail[base + b] = NO_WAY;
+        b_prev[base + b] = after;
+        b_next[base + b] = after == NO_WAY ? first[set] : b_next[base + after];
+        if (b_next[base + b] != NO_WAY) b_prev[base + b_next[base + b]] = b;
+        if (after == NO_WAY) first[set] = b; else b_next[base + after] = b;
+        return b;
+    }
+
+    void append(size_t set, size_t way, uint8_t b) {
+        size_t base = set * ways;
+        bucket[base + way] = b;
+        prev[base + way] = b_tail[base + b];
+        next[base + way] = NO_WAY;
+        if (b_tail[base + b] != NO_WAY) next[base + b_tail[base + b]] = (uint8_t)way;
+        else b_head[base + b] = (uint8_t)way;
+        b_tail[base + b] = (uint8_t)way;
+    }
+
+    // Unlinks a way from its bucket, releasing the bucket if it empties.
+    // Returns the bucket a higher frequency should follow: the way's own
+    // bucket while it is still in use, otherwise the one before it.
+    uint8_t detach(size_t set, size_t way) {
+        size_t base = set * ways;
+        uint8_t b = bucket[base + way];
+        uint8_t p = prev[base + way], n = next[base + way];
+        if (p != NO_WAY) next[base + p] = n; else b_head[base + b] = n;
+        if (n != NO_WAY) prev[base + n] = p; else b_tail[base + b] = p;
+        bucket[base + way] = NO_WAY;
+        if (b_head[base + b] != NO_WAY) return b;
+
+        uint8_t bp = b_prev[base + b], bn = b_next[base + b];
+        if (bp != NO_WAY) b_next[base + bp] = bn; else first[set] = bn;
+        if (bn != NO_WAY) b_prev[base + bn] = bp;
+        b_next[base + b] = free_slot[set];
+        free_slot[set] = b;
+        return bp;
+    }
+
+    void touch(size_t set, size_t way) {
+        size_t base = set * ways;
+        uint32_t f = ++freq[base + way];
+        uint8_t before = detach(set, way);
+        uint8_t nb = before == NO_WAY ? first[set] : b_next[base + before];
+        if (nb == NO_WAY || b_freq[base + nb] != f) nb = new_bucket(set, f, before);
+        append(set, way, nb);
+    }
+
+    void insert(size_t set, size_t way) {
+        size_t base = set * ways;
+        freq[base + way] = 1;
+        uint8_t b = first[set];
+        if (b == NO_WAY || b_freq[base + b] != 1) b = new_bucket(set, 1, NO_WAY);
+        append(set, way, b);
+    }
+
+    void remove(size_t set, size_t way) { detach(set, way); }
+
+    size_t victim(size_t set) {
+        size_t way = b_head[set * ways + first[set]];
+        detach(set, way);
+        return way;
+    }
+};
+
+// Tree pseudo-LRU: ways - 1 direction bits per set, heap-indexed from 1.
+// A set bit at a node means the victim lies in its right subtree.
+template <>
+struct Replacer<CachePolicy::PLRU> {
+    std::vector<uint64_t> bits;
+    size_t ways = 0;
+    unsigned levels = 0;
+
+    void init(size_t sets, size_t w) {
+        ways = w;
+        levels = __builtin_ctzll(w);
+        bits.assign(sets, 0);
+    }
+    template <typename R, typename F> static void state(R &r, F &&f) { f(r.bits); }
+    bool check(const std::vector<uint64_t> &) const { return true; }
+    void touch(size_t set, size_t way) {
+        uint64_t b = bits[set];
+        size_t node = 1;
+        for (unsigned l = levels; l-- > 0;) {
+            size_t right = (way >> l) & 1;
+            // point away from the way just used
+            if (right) b &= ~(1ULL << node); else b |= 1ULL << node;
+            node = 2 * node + right;
+        }
+        bits[set] = b;
+    }
+    void insert(size_t set, size_t way) { touch(set, way); }
+    void remove(size_t, size_t) {}
+    size_t victim(size_t set) {
+        size_t node = 1;
+        while (node < ways) node = 2 * node + ((bits[set] >> node) & 1);
+        return node - ways;
+    }
+};
+
+// SRRIP-HP: lines enter with RRPV 2, hits reset to 0, and the victim is the
+// first line at RRPV 3 after ageing the set as needed.
+template <>
+struct Replacer<CachePolicy::SRRIP> {
+    static constexpr uint8_t MAX_RRPV = 3;
+    std::vector<uint8_t> rrpv;
+    size_t ways = 0;
+
+    void init(size_t sets, size_t w) { ways = w; rrpv.assign(sets * w, MAX_RRPV); }
+    template <typename R, typename F> static void state(R &r, F &&f) { f(r.rrpv); }
+    bool check(const std::vector<uint64_t> &) const {
+        for (uint8_t v : rrpv)
+            if (v > MAX_RRPV) return false;
+        return true;
+    }
+    void touch(size_t set, size_t way) { rrpv[set * ways + way] = 0; }
+    void insert(size_t set, size_t way) { rrpv[set * ways + way] = MAX_RRPV - 1; }
+    void remove(size_t set, size_t way) { rrpv[set * ways + way] = MAX_RRPV; }
+    size_t victim(size_t set) {
+        uint8_t *r = &rrpv[set * ways];
+        uint8_t oldest = 0;
+        for (size_t w = 0; w < ways; w++) oldest = r[w] > oldest ? r[w] : oldest;
+        uint8_t age = MAX_RRPV - oldest;
+        size_t found = ways;
+        for (size_t w = 0; w < ways; w++) {
+            r[w] += age;
+            if (found == ways && r[w] == MAX_RRPV) found = w;
+        }
+        return found;
+    }
+};
@@ -0,0 +1,88 @@
+#include "sharded_cache.h"
+#include "spsc_queue.h"
+#include <thread>
+
+namespace {
+
+constexpr size_t BATCH = 1024;            // items buffered per shard before a push
+constexpr size_t QUEUE_ITEMS = 1 << 16;   // ring capacity per shard
+
+}  // namespace
+
+// Queue items are (block / K) << 1 | write.
+struct ShardedCacheSim::Shard {
+    MultiLevelCache cache;
+    SpscQueue<uint64_t> queue;
+    std::vector<uint64_t> pending;
+    std::thread worker;
+
+    Shard(const HierarchyConfig &c) : cache(c), queue(QUEUE_ITEMS) { pending.reserve(BATCH); }
+
+    void drain(size_t block) {
+        uint64_t items[BATCH];
+        while (size_t n = queue.pop(items, BATCH))
+            for (size_t i = 0; i < n; i++) cache.access((items[i] >> 1) * block, items[i] & 1);
+    }
+};
+
+ShardedCacheSim::ShardedCacheSim(const HierarchyConfig &config, size_t max_shards)
+    : cfg(config), block(config.levels[0].block) {
+    size_t k = 1;
+    while (k * 2 <= max_shards) {
+        bool divides = true;
+        for (const CacheLevelConfig &l : cfg.levels)
+            if (Cache::setsFor(l.size, l.block, l.assoc) % (k * 2) != 0) divides = false;
+        if (!divides) break;
+        k *= 2;
+        shard_bits++;
+    }
+
+    HierarchyConfig part = cfg;
+    for (CacheLevelConfig &l : part.levels) l.size /= k;
+    for (size_t i = 0; i < k; i++) parts.push_back(new Shard(part));
+    if (k > 1)
+        for (Shard *s : parts) s->worker = std::thread(&Shard::drain, s, block);
+}
+
+ShardedCacheSim::~ShardedCacheSim() {
+    finish();
+    for (Shard *s : parts) delete s;
+}
+
+void ShardedCacheSim::access(uint64_t address, bool write) {
+    uint64_t b = address / block;
+    if (parts.size() == 1) {
+        parts[0]->cache.access(address, write);
+        return;
+    }
+    Shard &s = *parts[b & (parts.size() - 1)];
+    s.pending.push_back((b >> shard_bits) << 1 | (write ? 1 : 0));
+    if (s.pending.size() == BATCH) flush(s);
+}
+
+void ShardedCacheSim::flush(Shard &s) {
+    s.queue.push(s.pending.data(), s.pending.size());
+    s.pending.clear();
+}
+
+void ShardedCacheSim::finish() {
+    if (finished) return;
+    finished = true;
+    if (parts.size() == 1) return;
+    for (Shard *s : parts) {
+        flush(*s);
+        s->queue.close();
+    }
+    for (Shard *s : parts) s->worker.join();
+}
+
+HierarchyCounters ShardedCacheSim::counters() const {
+    // Summed in shard order; the totals do not depend on thread timing.
+    HierarchyCounters total;
+    for (const Shard *s : parts) total += s->cache.counters();
+    return total;
+}
+
+void ShardedCacheSim::stats() const {
+    print_hierarchy_stats(counters(), cfg.inclusion, false);
+}
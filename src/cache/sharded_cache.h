@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "multilevel_cache.h"
+
+// Runs one cache hierarchy over a long access stream on several cores.
+//
+// Every level maps block number B to set B % sets, so when the shard count K
+// divides every level's set count, block B only ever meets blocks with the
+// same B % K: its sets, its victims and its back-invalidations all stay in
+// shard B % K. Each shard is the same hierarchy with every level 1/K the
+// size and sees block B / K, which lands in the same set and way as the
+// serial run would use. Counters are plain sums, so the merged result equals
+// the serial result exactly.
+//
+// 3C classification compares against one fully associative shadow of the
+// whole level, which does not partition by set, so it is off here.
+class ShardedCacheSim {
+public:
+    // K is the largest power of two <= max_shards that divides every level's
+    // set count (1 means serial).
+    ShardedCacheSim(const HierarchyConfig &config, size_t max_shards);
+
+    // Feeds accesses in order. address/write pairs are routed to the owning
+    // shard; with more than one shard a consumer thread per shard runs until
+    // finish() is called.
+    void access(uint64_t address, bool write);
+    void finish();
+
+    size_t shards() const { return parts.size(); }
+    HierarchyCounters counters() const;
+    void stats() const;
+
+    ~ShardedCacheSim();
+    ShardedCacheSim(const ShardedCacheSim &) = delete;
+    ShardedCacheSim &operator=(const ShardedCacheSim &) = delete;
+
+private:
+    struct Shard;
+
+    HierarchyConfig cfg;
+    size_t block;
+    unsigned shard_bits = 0;
+    std::vector<Shard *> parts;
+    bool finished = false;
+
+    void flush(Shard &s);
+};
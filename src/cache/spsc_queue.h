@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Bounded single-producer single-consumer ring. Head and tail live on their
+// own cache lines and each side publishes with one release store per bulk
+// call, so a batch of items costs two atomic operations, not two per item.
+template <typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two.
+    explicit SpscQueue(size_t capacity) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        ring.resize(cap);
+        mask = cap - 1;
+    }
+
+    // Producer side. Blocks (yielding) until all n items are queued.
+    void push(const T *items, size_t n) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        while (n) {
+            size_t room = ring.size() - (t - head.load(std::memory_order_acquire));
+            if (room == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            size_t k = n < room ? n : room;
+            for (size_t i = 0; i < k; i++) ring[(t + i) & mask] = items[i];
+            t += k;
+            items += k;
+            n -= k;
+            tail.store(t, std::memory_order_release);
+        }
+    }
+
+    void close() { closed.store(true, std::memory_order_release); }
+
+    // Consumer side. Returns up to max items; 0 only once the queue is
+    // closed and drained.
+    size_t pop(T *out, size_t max) {
+        size_t h = head.load(std::memory_order_relaxed);
+        while (true) {
+            bool done = closed.load(std::memory_order_acquire);
+            size_t avail = tail.load(std::memory_order_acquire) - h;
+            if (avail) {
+                size_t k = avail < max ? avail : max;
+                for (size_t i = 0; i < k; i++) out[i] = ring[(h + i) & mask];
+                head.store(h + k, std::memory_order_release);
+                return k;
+            }
+            if (done) return 0;
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::vector<T> ring;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<bool> closed{false};
+};
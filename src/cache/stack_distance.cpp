@@ -0,0 +1,118 @@
+#include "stack_distance.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+
+constexpr uint64_t SAMPLE_MOD = 1ULL << 24;
+constexpr size_t MIN_SLOTS = 1 << 16;
+
+uint64_t mix(uint64_t x) {
+    // splitmix64 finaliser: spreads block numbers evenly for sampling
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+}  // namespace
+
+StackDistanceProfiler::StackDistanceProfiler(size_t block_size, double sample_rate)
+    : block(block_size ? block_size : 1), rate(sample_rate) {
+    if (rate <= 0.0 || rate > 1.0) rate = 1.0;
+    threshold = (uint64_t)(rate * SAMPLE_MOD);
+    if (threshold == 0) threshold = 1;
+    tree.assign(MIN_SLOTS + 1, 0);
+}
+
+void StackDistanceProfiler::add(uint64_t slot, int delta) {
+    for (uint64_t i = slot + 1; i < tree.size(); i += i & (~i + 1)) tree[i] += delta;
+}
+
+uint64_t StackDistanceProfiler::prefix(uint64_t slot) const {
+    uint64_t sum = 0;
+    for (uint64_t i = slot + 1; i > 0; i -= i & (~i + 1)) sum += tree[i];
+    return sum;
+}
+
+// Time slots only grow, so once they run out the live marks (one per
+// tracked block) are renumbered densely in time order and the tree rebuilt.
+void StackDistanceProfiler::compact() {
+    std::vector<std::pair<uint64_t, uint64_t>> order;   // (slot, block)
+    order.reserve(last_access.size());
+    for (const auto &e : last_access) order.push_back({e.second, e.first});
+    std::sort(order.begin(), order.end());
+
+    size_t slots = std::max(MIN_SLOTS, order.size() * 2);
+    tree.assign(slots + 1, 0);
+    for (size_t i = 0; i < order.size(); i++) {
+        last_access[order[i].second] = i;
+        tree[i + 1] = 1;
+    }
+    // O(n) Fenwick build: push each node's sum to its parent.
+    for (size_t i = 1; i <= slots; i++) {
+        size_t parent = i + (i & (~i + 1));
+        if (parent <= slots) tree[parent] += tree[i];
+    }
+    now = order.size();
+}
+
+void StackDistanceProfiler::observe(uint64_t address) {
+    total++;
+    uint64_t b = address / block;
+    if (threshold < SAMPLE_MOD && (mix(b) & (SAMPLE_MOD - 1)) >= threshold) return;
+    sampled++;
+
+    if (now + 1 >= tree.size()) compact();
+
+    auto it = last_access.find(b);
+    if (it == last_access.end()) {
+        cold++;
+        last_access.emplace(b, now);
+    } else {
+        // distinct blocks referenced since: marks after the previous slot
+        uint64_t distance = last_access.size() - prefix(it->second);
+        if (distance >= histogram.size()) histogram.resize(distance + 1, 0);
+        histogram[distance]++;
+        add(it->second, -1);
+        it->second = now;
+    }
+    add(now, 1);
+    now++;
+}
+
+uint64_t StackDistanceProfiler::distinctBlocks() const {
+    return (uint64_t)(last_access.size() / rate);
+}
+
+double StackDistanceProfiler::miss_ratio(uint64_t blocks) const {
+    if (!sampled) return 0.0;
+    // A sampled distance d stands for d / rate blocks of the full stream.
+    uint64_t misses = cold;
+    for (size_t d = 0; d < histogram.size(); d++)
+        if ((double)d / rate >= (double)blocks) misses += histogram[d];
+    return (double)misses / sampled;
+}
+
+void StackDistanceProfiler::report() const {
+    std::cout << "\n=== MISS RATIO CURVE (fully associative LRU, " << block << "-byte blocks) ===\n";
+    std::cout << "References: " << total << "  Sampled: " << sampled;
+    if (rate < 1.0) std::cout << " (rate " << rate << ")";
+    std::cout << "  Distinct blocks: " << distinctBlocks() << "\n";
+
+    uint64_t footprint = std::max<uint64_t>(distinctBlocks(), 1);
+    std::vector<uint64_t> sizes;
+    for (uint64_t c = 1; ; c *= 2) {
+        sizes.push_back(c);
+        if (c >= footprint) break;
+    }
+    std::cout << "Size (bytes)    Blocks    Miss ratio\n";
+    for (uint64_t c : sizes) {
+        std::cout << c * block;
+        for (size_t pad = std::to_string(c * block).size(); pad < 16; pad++) std::cout << ' ';
+        std::cout << c;
+        for (size_t pad = std::to_string(c).size(); pad < 10; pad++) std::cout << ' ';
+        std::cout << miss_ratio(c) * 100.0 << "%\n";
+    }
+}
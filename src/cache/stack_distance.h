@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Mattson stack-distance profiler. One pass over an address stream yields the
+// miss ratio of a fully associative LRU cache of every size (for one block
+// size): a reference misses in a cache of C blocks exactly when fewer than C
+// distinct blocks separate it from the previous reference to the same block.
+//
+// The distance is counted with a Fenwick tree over access times that holds a
+// mark at each block's most recent access, so every reference is O(log n).
+// With sample_rate < 1 only blocks whose hash falls under a threshold are
+// tracked (SHARDS fixed-rate sampling) and distances are scaled by 1/rate,
+// which bounds memory on traces with very large footprints.
+class StackDistanceProfiler {
+public:
+    explicit StackDistanceProfiler(size_t block_size, double sample_rate = 1.0);
+
+    void observe(uint64_t address);
+
+    // Estimated misses / references for an LRU cache holding `blocks` lines.
+    double miss_ratio(uint64_t blocks) const;
+
+    uint64_t references() const { return total; }
+    uint64_t sampledReferences() const { return sampled; }
+    uint64_t distinctBlocks() const;   // estimated, scaled by 1/rate
+    size_t blockSize() const { return block; }
+    double sampleRate() const { return rate; }
+
+    // Miss-ratio table for power-of-two cache sizes up to the footprint.
+    void report() const;
+
+private:
+    size_t block;
+    double rate;
+    uint64_t threshold;   // sample when hash(block) mod 2^24 < threshold
+
+    uint64_t total = 0;
+    uint64_t sampled = 0;
+    uint64_t cold = 0;
+    std::vector<uint64_t> histogram;   // sampled references by raw distance
+
+    std::unordered_map<uint64_t, uint64_t> last_access;   // block -> time slot
+    std::vector<uint32_t> tree;                           // Fenwick tree, 1-based
+    uint64_t now = 0;
+
+    void add(uint64_t slot, int delta);
+    uint64_t prefix(uint64_t slot) const;   // marks in slots [0, slot]
+    void compact();
+};
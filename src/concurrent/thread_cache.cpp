@@ -0,0 +1,238 @@
+#include "thread_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+constexpr uint64_t MIN_CLASS = 16;
+constexpr uint64_t MAX_CLASS = 32 * 1024;
+
+// Handles: small objects are address << 6 | class, large objects set the
+// top bit over their page-heap id.
+constexpr uint64_t LARGE_BIT = 1ULL << 63;
+constexpr unsigned CLASS_BITS = 6;
+
+// Takes `m`, timing the wait only when the lock is contended.
+void timed_lock(std::mutex &m, ThreadCacheStats &st) {
+    st.lock_acquires++;
+    if (m.try_lock()) return;
+    st.lock_contended++;
+    auto t0 = std::chrono::steady_clock::now();
+    m.lock();
+    st.lock_wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - t0).count();
+}
+
+}  // namespace
+
+CentralHeap::CentralHeap(size_t heap_size, size_t span) : span_size(span) {
+    // Powers of two and the midpoints between them, as in the slab layer.
+    for (uint64_t p = MIN_CLASS; p <= MAX_CLASS; p *= 2) {
+        class_size.push_back(p);
+        if (p + p / 2 <= MAX_CLASS && p >= 32) class_size.push_back(p + p / 2);
+    }
+    lists.reset(new ClassList[class_size.size()]);
+    pages.init(heap_size);
+}
+
+size_t CentralHeap::classFor(uint64_t size) const {
+    return std::lower_bound(class_size.begin(), class_size.end(), size) - class_size.begin();
+}
+
+bool CentralHeap::grow(size_t cls, ThreadCacheStats &st) {
+    uint64_t obj = class_size[cls];
+    uint64_t span = std::max<uint64_t>(span_size, obj * ThreadCache::BATCH);
+    timed_lock(page_lock, st);
+    std::lock_guard<std::mutex> g(page_lock, std::adopt_lock);
+    int id = pages.malloc_block(span);
+    size_t base;
+    if (id == -1 || !pages.block_address(id, base)) return false;
+    // Spans stay with their class for the life of the heap, as in tcmalloc
+    // without a scavenger.
+    std::vector<uint64_t> &free = lists[cls].free;
+    for (uint64_t off = span / obj * obj; off >= obj; off -= obj) free.push_back(base + off - obj);
+    return true;
+}
+
+size_t CentralHeap::fetch(size_t cls, uint64_t *out, size_t n, ThreadCacheStats &st) {
+    ClassList &l = lists[cls];
+    timed_lock(l.lock, st);
+    std::lock_guard<std::mutex> g(l.lock, std::adopt_lock);
+    if (l.free.size() < n) grow(cls, st);
+    size_t k = std::min(n, l.free.size());
+    std::copy(l.free.end() - k, l.free.end(), out);
+    l.free.resize(l.free.size() - k);
+    return k;
+}
+
+void CentralHeap::release(size_t cls, const uint64_t *in, size_t n, ThreadCacheStats &st) {
+    ClassList &l = lists[cls];
+    timed_lock(l.lock, st);
+    std::lock_guard<std::mutex> g(l.lock, std::adopt_lock);
+    l.free.insert(l.free.end(), in, in + n);
+}
+
+int CentralHeap::allocateLarge(uint64_t size, uint64_t &address, ThreadCacheStats &st) {
+    timed_lock(page_lock, st);
+    std::lock_guard<std::mutex> g(page_lock, std::adopt_lock);
+    int id = pages.malloc_block(size);
+    size_t base = 0;
+    if (id != -1) pages.block_address(id, base);
+    address = base;
+    return id;
+}
+
+void CentralHeap::freeLarge(int id, ThreadCacheStats &st) {
+    timed_lock(page_lock, st);
+    std::lock_guard<std::mutex> g(page_lock, std::adopt_lock);
+    pages.free_block(id);
+}
+
+ThreadCache::ThreadCache(CentralHeap &heap) : central(heap), cached(heap.numClasses()) {
+    for (auto &c : cached) c.reserve(2 * BATCH + 1);
+}
+
+ThreadCache::~ThreadCache() {
+    for (size_t cls = 0; cls < cached.size(); cls++)
+        if (!cached[cls].empty()) central.release(cls, cached[cls].data(), cached[cls].size(), stats);
+}
+
+bool ThreadCache::allocate(uint64_t size, uint64_t &address, uint64_t &handle) {
+    stats.mallocs++;
+    if (size == 0) size = 1;
+    size_t cls = central.classFor(size);
+    if (cls == cached.size()) {
+        stats.large++;
+        int id = central.allocateLarge(size, address, stats);
+        if (id == -1) {
+            stats.failures++;
+            return false;
+        }
+        handle = LARGE_BIT | (uint64_t)id;
+        return true;
+    }
+
+    std::vector<uint64_t> &list = cached[cls];
+    if (list.empty()) {
+        stats.refills++;
+        uint64_t batch[BATCH];
+        size_t got = central.fetch(cls, batch, BATCH, stats);
+        if (got == 0) {
+            stats.failures++;
+            return false;
+        }
+        list.assign(batch, batch + got);
+    } else {
+        stats.cache_hits++;
+    }
+    address = list.back();
+    list.pop_back();
+    handle = address << CLASS_BITS | cls;
+    return true;
+}
+
+void ThreadCache::free(uint64_t handle) {
+    stats.frees++;
+    if (handle & LARGE_BIT) {
+        central.freeLarge((int)(handle & ~LARGE_BIT), stats);
+        return;
+    }
+    size_t cls = handle & ((1u << CLASS_BITS) - 1);
+    std::vector<uint64_t> &list = cached[cls];
+    list.push_back(handle >> CLASS_BITS);
+    if (list.size() > 2 * BATCH) {
+        stats.drains++;
+        central.release(cls, list.data() + list.size() - BATCH, BATCH, stats);
+        list.resize(list.size() - BATCH);
+    }
+}
+
+std::vector<ThreadCacheStats> run_concurrent_replay(const std::vector<const TraceFile *> &traces,
+                                                    size_t threads, size_t heap_size, double &wall_seconds) {
+    CentralHeap heap(heap_size);
+    std::vector<ThreadCacheStats> results(threads);
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+
+    auto worker = [&](size_t t) {
+        const TraceFile &trace = *traces[t % traces.size()];
+        ThreadCache cache(heap);
+        std::vector<uint64_t> handles(1);   // per-thread ids start at 1
+        std::vector<bool> live(1);
+
+        ready++;
+        while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+        auto t0 = std::chrono::steady_clock::now();
+        for (const TraceRecord &r : trace) {
+            if ((TraceOp)r.op == TraceOp::MALLOC) {
+                uint64_t address, handle;
+                if (cache.allocate(r.arg, address, handle)) {
+                    handles.push_back(handle);
+                    live.push_back(true);
+                }
+            } else if ((TraceOp)r.op == TraceOp::FREE) {
+                if (r.arg == 0 || r.arg >= handles.size() || !live[r.arg]) {
+                    cache.stats.failures++;
+                    continue;
+                }
+                live[r.arg] = false;
+                cache.free(handles[r.arg]);
+            }
+        }
+        cache.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        results[t] = cache.stats;
+        // Objects still live at the end of the trace are leaked, as in the
+        // single-threaded replay; the cache destructor only returns its lists.
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; t++) pool.emplace_back(worker, t);
+    while (ready.load() < threads) std::this_thread::yield();
+    auto t0 = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread &th : pool) th.join();
+    wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return results;
+}
+
+void print_concurrent_summary(const std::vector<ThreadCacheStats> &per_thread, double wall_seconds) {
+    std::cout << "\n=== CONCURRENT REPLAY (" << per_thread.size() << " threads) ===\n";
+    std::cout << std::left << std::setw(8) << "Thread" << std::setw(12) << "Ops" << std::setw(12) << "Hit rate"
+              << std::setw(10) << "Refills" << std::setw(10) << "Drains" << std::setw(18) << "Contended locks"
+              << "Lock wait (us)\n";
+
+    ThreadCacheStats total;
+    for (size_t t = 0; t < per_thread.size(); t++) {
+        const ThreadCacheStats &s = per_thread[t];
+        std::ostringstream hit, locks;
+        hit << std::fixed << std::setprecision(2) << s.hit_rate() << "%";
+        locks << s.lock_contended << "/" << s.lock_acquires;
+        std::cout << std::setw(8) << t << std::setw(12) << s.mallocs + s.frees << std::setw(12) << hit.str()
+                  << std::setw(10) << s.refills << std::setw(10) << s.drains << std::setw(18) << locks.str()
+                  << s.lock_wait_ns / 1000 << "\n";
+        total.mallocs += s.mallocs;
+        total.frees += s.frees;
+        total.failures += s.failures;
+        total.cache_hits += s.cache_hits;
+        total.large += s.large;
+        total.lock_acquires += s.lock_acquires;
+        total.lock_contended += s.lock_contended;
+        total.lock_wait_ns += s.lock_wait_ns;
+    }
+    std::cout << std::right;
+
+    uint64_t ops = total.mallocs + total.frees;
+    std::cout << "Total ops: " << ops << "  Failed: " << total.failures << "\n";
+    std::cout << "Thread cache hit rate: " << std::fixed << std::setprecision(2) << total.hit_rate() << "%\n";
+    std::cout << "Central locks: " << total.lock_acquires << " acquired, " << total.lock_contended
+              << " contended, " << total.lock_wait_ns / 1000 << " us waiting\n";
+    std::cout << "Elapsed: " << std::setprecision(6) << wall_seconds << " s";
+    if (wall_seconds > 0) std::cout << " (" << (uint64_t)(ops / wall_seconds) << " ops/s)";
+    std::cout << "\n";
+    std::cout.unsetf(std::ios::fixed);
+}
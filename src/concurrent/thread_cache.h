@@ -0,0 +1,95 @@
+#ifndef THREAD_CACHE_H
+#define THREAD_CACHE_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../allocator/memory_manager.h"
+#include "../trace/trace.h"
+
+// Per-thread counters; every thread owns one, so they need no atomics.
+struct ThreadCacheStats {
+    uint64_t mallocs = 0, frees = 0, failures = 0;
+    uint64_t cache_hits = 0;   // small mallocs served without touching the central heap
+    uint64_t refills = 0, drains = 0;
+    uint64_t large = 0;        // requests above the largest class
+    uint64_t lock_acquires = 0, lock_contended = 0;
+    uint64_t lock_wait_ns = 0;
+    double seconds = 0.0;
+
+    double hit_rate() const {
+        uint64_t small = mallocs - large;
+        return small ? (double)cache_hits / small * 100.0 : 0.0;
+    }
+};
+
+// Shared heap behind the thread caches, modelled on tcmalloc's central free
+// lists. Each size class has its own mutex-protected list of free object
+// addresses that thread caches take from and return to in batches. Spans of
+// address space for new objects, and large objects, come from a
+// MemoryManagerSimulator page heap behind a separate lock.
+class CentralHeap {
+public:
+    CentralHeap(size_t heap_size, size_t span_size = 64 * 1024);
+
+    size_t numClasses() const { return class_size.size(); }
+    size_t classFor(uint64_t size) const;   // numClasses() when too large
+    uint64_t classSize(size_t cls) const { return class_size[cls]; }
+
+    // Moves up to n free objects of class `cls` into out; returns the count.
+    size_t fetch(size_t cls, uint64_t *out, size_t n, ThreadCacheStats &st);
+    void release(size_t cls, const uint64_t *in, size_t n, ThreadCacheStats &st);
+
+    int allocateLarge(uint64_t size, uint64_t &address, ThreadCacheStats &st);
+    void freeLarge(int id, ThreadCacheStats &st);
+
+private:
+    struct alignas(64) ClassList {
+        std::mutex lock;
+        std::vector<uint64_t> free;
+    };
+
+    size_t span_size;
+    std::vector<uint64_t> class_size;
+    std::unique_ptr<ClassList[]> lists;
+    std::mutex page_lock;
+    MemoryManagerSimulator pages;
+
+    // Carves a new span into class objects; called with the class lock held.
+    bool grow(size_t cls, ThreadCacheStats &st);
+};
+
+// One thread's cache: a free-address stack per size class. An empty stack
+// refills BATCH objects from the central heap; a stack that grows past
+// 2 * BATCH drains BATCH back, so memory freed on one thread's hot path
+// does not pile up there.
+class ThreadCache {
+public:
+    static constexpr size_t BATCH = 32;
+
+    explicit ThreadCache(CentralHeap &heap);
+    ~ThreadCache();   // returns every cached object to the central heap
+
+    // Returns a handle for free(); address receives the object's address.
+    bool allocate(uint64_t size, uint64_t &address, uint64_t &handle);
+    void free(uint64_t handle);
+
+    ThreadCacheStats stats;
+
+private:
+    CentralHeap &central;
+    std::vector<std::vector<uint64_t>> cached;
+};
+
+// Runs one trace per thread (MALLOC/FREE records; ids are per thread) against
+// one shared CentralHeap. With more threads than traces, traces are reused
+// round-robin, so one trace can drive a 1..N thread scaling study.
+// wall_seconds covers the replay from the common start to the last thread.
+std::vector<ThreadCacheStats> run_concurrent_replay(const std::vector<const TraceFile *> &traces,
+                                                    size_t threads, size_t heap_size, double &wall_seconds);
+
+void print_concurrent_summary(const std::vector<ThreadCacheStats> &per_thread, double wall_seconds);
+
+#endif
@@ -1,41 +1,311 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <sstream>
 #include "allocator/memory_manager.h"
 #include "buddy/buddy_allocator.h"
 #include "cache/cache.h"
 #include "cache/multilevel_cache.h"
+#include "cache/sharded_cache.h"
+#include "concurrent/thread_cache.h"
+#include "slab/slab_allocator.h"
+#include "cache/stack_distance.h"
+#include "sweep/sweep.h"
+#include "trace/trace.h"
+#include "vm/virtual_memory.h"
+#include "profile/profile.h"
+#include "telemetry/frag_telemetry.h"
+#include "snapshot/snapshot.h"
+#include <thread>
 
-int main() {
+static bool replay_file(const std::string &path, MemoryManagerSimulator &mm, BuddyAllocator *&ba,
+                        SlabAllocator *&slab, VirtualMemory *&vm, MultiLevelCache &cache,
+                        ReplaySummary &summary) {
+    TraceFile trace;
+    std::string err;
+    if (!trace.open(path, err)) {
+        std::cout << "Replay failed: " << err << "\n";
+        return false;
+    }
+    TraceReplayer replayer(mm, ba, cache);
+    replayer.attachSlab(slab);
+    replayer.attachVm(vm);
+    summary = replayer.run(trace.begin(), trace.end());
+    print_replay_summary(summary);
+    return true;
+}
+
+// One pass over the ACCESS records of a trace gives the LRU miss ratio for
+// every cache size, instead of one replay per configuration.
+static bool profile_trace(const std::string &path, size_t block_size, double sample_rate) {
+    TraceFile trace;
+    std::string err;
+    if (!trace.open(path, err)) {
+        std::cout << "Profile failed: " << err << "\n";
+        return false;
+    }
+    StackDistanceProfiler profiler(block_size, sample_rate);
+    for (const TraceRecord &r : trace)
+        if ((TraceOp)r.op == TraceOp::ACCESS) profiler.observe(r.arg);
+    profiler.report();
+    return true;
+}
+
+// The ACCESS records of a trace through the current hierarchy, split by set
+// across threads. Leaves the interactive cache untouched.
+static bool replay_cache_sharded(const std::string &path, const HierarchyConfig &config, size_t threads) {
+    TraceFile trace;
+    std::string err;
+    if (!trace.open(path, err)) {
+        std::cout << "Replay failed: " << err << "\n";
+        return false;
+    }
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    auto t0 = std::chrono::steady_clock::now();
+    ShardedCacheSim sim(config, threads);
+    uint64_t accesses = 0;
+    for (const TraceRecord &r : trace)
+        if ((TraceOp)r.op == TraceOp::ACCESS) {
+            sim.access(r.arg, (r.flags & ACCESS_WRITE) != 0);
+            accesses++;
+        }
+    sim.finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "\n=== SHARDED CACHE REPLAY ===\n";
+    std::cout << "Accesses: " << accesses << "  Shards: " << sim.shards() << "\n";
+    std::cout << "Elapsed: " << seconds << " s";
+    if (seconds > 0) std::cout << " (" << (uint64_t)(accesses / seconds) << " accesses/s)";
+    std::cout << "\n";
+    sim.stats();
+    return true;
+}
+
+// Per-thread traces against one shared central heap behind thread caches.
+static bool concurrent_replay(size_t threads, size_t heap_size, const std::vector<std::string> &paths) {
+    std::vector<std::unique_ptr<TraceFile>> files;
+    std::vector<const TraceFile *> traces;
+    for (const std::string &path : paths) {
+        files.emplace_back(new TraceFile);
+        std::string err;
+        if (!files.back()->open(path, err)) {
+            std::cout << "Replay failed: " << err << "\n";
+            return false;
+        }
+        traces.push_back(files.back().get());
+    }
+    if (traces.empty() || threads == 0 || heap_size == 0) {
+        std::cout << "Replay failed: need a thread count, a heap size and at least one trace\n";
+        return false;
+    }
+    double seconds = 0;
+    std::vector<ThreadCacheStats> stats = run_concurrent_replay(traces, threads, heap_size, seconds);
+    print_concurrent_summary(stats, seconds);
+    return true;
+}
+
+// Every configuration of the grid against one trace, in parallel; CSV on stdout.
+static bool sweep_files(const std::string &grid_path, const std::string &trace_path, size_t threads) {
+    std::ifstream in(grid_path);
+    SweepGrid grid;
+    std::string err;
+    if (!in) err = "cannot open " + grid_path;
+    TraceFile trace;
+    if (err.empty() && parse_sweep_grid(in, grid, err) && trace.open(trace_path, err)) {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        print_sweep_csv(run_sweep(grid, trace, threads ? threads : 1));
+        return true;
+    }
+    std::cout << "Sweep failed: " << err << "\n";
+    return false;
+}
+
+static bool start_telemetry(FragTelemetry &telemetry, MemoryManagerSimulator &mm, const std::string &path,
+                            uint64_t interval) {
+    std::string err;
+    if (!telemetry.open(path, interval, err)) {
+        std::cout << "Telemetry failed: " << err << "\n";
+        return false;
+    }
+    mm.attach_telemetry(&telemetry);
+    return true;
+}
+
+static void stop_telemetry(FragTelemetry &telemetry, MemoryManagerSimulator &mm) {
+    if (!telemetry.active()) return;
+    mm.attach_telemetry(nullptr);
+    uint64_t samples = telemetry.samples();
+    if (telemetry.close()) std::cout << "Telemetry: " << samples << " samples written to " << telemetry.path() << "\n";
+    else std::cout << "Telemetry: write error on " << telemetry.path() << "\n";
+}
+
+// Slab and VM state live on the buddy heap, which a load replaces, so they
+// are dropped first: their destructors hand memory back to the old heap.
+static bool load_image_file(const std::string &path, MemoryManagerSimulator &mm, BuddyAllocator *&ba,
+                            SlabAllocator *&slab, VirtualMemory *&vm, MultiLevelCache &cache) {
+    std::string err;
+    BuddyAllocator *loaded = nullptr;
+    if (!load_simulator_image(path, mm, cache, loaded, err)) {
+        std::cout << "Load failed: " << err << "\n";
+        return false;
+    }
+    delete vm;
+    vm = nullptr;
+    delete slab;
+    slab = nullptr;
+    delete ba;
+    ba = loaded;
+    return true;
+}
+
+int main(int argc, char **argv) {
     MemoryManagerSimulator mm;
     std::string cmd;
 
-    Cache L1(256, 64, 1, CachePolicy::FIFO);
-    Cache L2(1024, 64, 4, CachePolicy::LRU);
-    MultiLevelCache cache(L1, L2);              
+    // Quiet mode drops the prompt and per-operation messages so long
+    // workloads only print what dump/stats commands ask for.
+    bool quiet = false;
+    // --telemetry <file> <interval> samples fragmentation during any mode below.
+    FragTelemetry telemetry;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--quiet") quiet = true;
+        if (std::string(argv[i]) == "--telemetry" && i + 2 < argc &&
+            !start_telemetry(telemetry, mm, argv[i + 1], std::strtoull(argv[i + 2], nullptr, 10)))
+            return 1;
+    }
+
+    MultiLevelCache cache(default_hierarchy());
 
-    std::cout << "Memory Management Simulator Ready. Type 'help' for commands.\n";
     BuddyAllocator* ba = nullptr;
+    SlabAllocator* slab = nullptr;   // sits on top of ba; dropped when ba is replaced
+    VirtualMemory* vm = nullptr;     // frames come from ba; dropped along with slab
+
+    // --load <image> starts every mode below from a saved snapshot.
+    bool loaded = false;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) != "--load") continue;
+        auto t0 = std::chrono::steady_clock::now();
+        if (!load_image_file(argv[i + 1], mm, ba, slab, vm, cache)) return 1;
+        loaded = true;
+        std::cout << "Loaded " << argv[i + 1] << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() << " ms\n";
+    }
+
+    // Batch modes: --convert <text> <trace>, --replay <trace>,
+    // --mrc <trace> <block_size> [sample_rate], --sweep <grid> <trace> [threads] and
+    // --mt-replay <threads> <heap_size> <trace>... and
+    // --telemetry-csv <telemetry_file> <csv_file>
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--convert" && i + 2 < argc) {
+            std::ifstream in(argv[i + 1]);
+            size_t records = 0;
+            std::string err;
+            if (!in || !convert_text_trace(in, argv[i + 2], records, err)) {
+                std::cout << "Convert failed: " << (in ? err : std::string("cannot open ") + argv[i + 1]) << "\n";
+                return 1;
+            }
+            std::cout << "Wrote " << records << " records to " << argv[i + 2] << "\n";
+            return 0;
+        }
+        if (arg == "--replay" && i + 1 < argc) {
+            ReplaySummary summary;
+            if (!replay_file(argv[i + 1], mm, ba, slab, vm, cache, summary)) return 1;
+            if (summary.mallocs || summary.frees) mm.stats();
+            if (ba) ba->stats();
+            if (slab) slab->stats();
+            if (vm) vm->stats();
+            if (summary.accesses || summary.touches || summary.vm_accesses) cache.stats();
+            stop_telemetry(telemetry, mm);
+            delete vm;
+            delete slab;
+            delete ba;
+            return 0;
+        }
+        if (arg == "--mrc" && i + 2 < argc) {
+            double rate = i + 3 < argc ? std::atof(argv[i + 3]) : 1.0;
+            return profile_trace(argv[i + 1], std::strtoull(argv[i + 2], nullptr, 10), rate) ? 0 : 1;
+        }
+        if (arg == "--sweep" && i + 2 < argc) {
+            size_t threads = i + 3 < argc ? std::strtoull(argv[i + 3], nullptr, 10) : 0;
+            return sweep_files(argv[i + 1], argv[i + 2], threads) ? 0 : 1;
+        }
+        if (arg == "--mt-replay" && i + 3 < argc) {
+            std::vector<std::string> paths(argv + i + 3, argv + argc);
+            return concurrent_replay(std::strtoull(argv[i + 1], nullptr, 10),
+                                     std::strtoull(argv[i + 2], nullptr, 10), paths) ? 0 : 1;
+        }
+        if (arg == "--telemetry-csv" && i + 2 < argc) {
+            uint64_t rows = 0;
+            std::string err;
+            if (!frag_telemetry_to_csv(argv[i + 1], argv[i + 2], rows, err)) {
+                std::cout << "Convert failed: " << err << "\n";
+                return 1;
+            }
+            std::cout << "Wrote " << rows << " rows to " << argv[i + 2] << "\n";
+            return 0;
+        }
+    }
+
+    // `cache stats` in the REPL shows the 3C breakdown, so the interactive
+    // hierarchy classifies misses; batch replays above skip the cost. A
+    // loaded image keeps the setting it was saved with.
+    if (!loaded) cache.setMissClassification(true);
+
+    std::cout << "Memory Management Simulator Ready. Type 'help' for commands.\n";
     while (true) {
-        std::cout << "> ";
-        std::cin >> cmd;
+        if (!quiet) std::cout << "> ";
+        if (!(std::cin >> cmd)) break;
 
        if (cmd == "help") {
             std::cout << "\nCommands:\n";
             std::cout << "  init memory <size>\n";
-            std::cout << "  set allocator <first_fit | best_fit | worst_fit>\n";
+            std::cout << "  set allocator <first_fit | best_fit | worst_fit | next_fit | tlsf>\n";
+            std::cout << "  set compaction <off | full | incremental> [frag_threshold_%] [budget_bytes]\n";
+            std::cout << "  compact   (slide every live block down now)\n";
             std::cout << "  malloc <size>\n";
             std::cout << "  free <block_id>\n";
             std::cout << "  dump memory\n";
             std::cout << "  visualize\n";
             std::cout << "  stats\n";
-            std::cout << "  access <address>   (simulate cache access)\n";
+            std::cout << "  access <address> [w]   (simulate cache read, or write with w)\n";
+            std::cout << "  touch <block_id> <offset> [w]   (access a byte of a live block through the cache)\n";
+            std::cout << "  buddy_touch <block_id> <offset> [w]\n";
+            std::cout << "  slab_touch <object_id> <offset> [w]\n";
+            std::cout << "  cache config <size:block:assoc:policy>... [inclusive | exclusive | nine]\n";
+            std::cout << "               [write_back | write_through] [allocate | no_allocate]\n";
+            std::cout << "  cache replay <trace_file> [threads]   (accesses only, sharded by set)\n";
             std::cout << "  cache dump\n";
             std::cout << "  cache stats\n";
-            std::cout << "  buddy_init <size>\n";
+            std::cout << "  cache classify <on | off>   (3C miss classification)\n";
+            std::cout << "  buddy_init <size> [free_list | bitmap] [min_block]\n";
             std::cout << "  buddy_malloc <size>\n";
             std::cout << "  buddy_free <block_id>\n";
             std::cout << "  buddy_dump\n";
             std::cout << "  buddy_stats\n";
+            std::cout << "  slab_init [slab_size]   (size-class caches on the buddy heap)\n";
+            std::cout << "  slab_malloc <size>\n";
+            std::cout << "  slab_free <object_id>\n";
+            std::cout << "  slab_stats\n";
+            std::cout << "  vm_init [tlb_entries] [tlb_assoc] [policy]   (page tables + TLB, frames from buddy)\n";
+            std::cout << "  vm_create [page_size]   (4096 ... 1073741824, e.g. 2097152 for huge pages)\n";
+            std::cout << "  vm_access <pid> <virtual_address> [w]\n";
+            std::cout << "  vm_paging <frames> <fifo | lru | clock | arc> [ws_window]   (0 frames = buddy heap)\n";
+            std::cout << "  vm_destroy <pid>\n";
+            std::cout << "  vm_stats\n";
+            std::cout << "  replay <trace_file>   (binary trace, see --convert)\n";
+            std::cout << "  save <image_file>   (heap, buddy heap and cache contents)\n";
+            std::cout << "  load <image_file>   (drops slab and VM state)\n";
+            std::cout << "  mrc <trace_file> <block_size> [sample_rate]   (LRU miss-ratio curve)\n";
+            std::cout << "  sweep <grid_file> <trace_file> [threads]   (CSV row per configuration)\n";
+            std::cout << "  mt_replay <threads> <heap_size> <trace_file>...   (thread caches + central heap)\n";
+            std::cout << "  telemetry <file> [interval] | telemetry off   (fragmentation every N malloc/free; .csv or binary)\n";
+            std::cout << "  profile [reset]   (p50/p99/p999 per operation; build with -DMEMSIM_PROFILE)\n";
+            std::cout << "  quiet <on | off>\n";
             std::cout << "  exit\n\n";
 }
 
@@ -54,11 +324,21 @@ int main() {
             std::string type, policy;
             std::cin >> type >> policy;
             if (type == "allocator") {
-                if (policy == "first_fit") mm.setAllocator(AllocatorType::FIRST_FIT);
-                else if (policy == "best_fit") mm.setAllocator(AllocatorType::BEST_FIT);
-                else if (policy == "worst_fit") mm.setAllocator(AllocatorType::WORST_FIT);
+                AllocatorType t;
+                if (parse_allocator_type(policy, t)) mm.setAllocator(t);
                 else std::cout << "Unknown allocator policy\n";
             }
+            else if (type == "compaction") {
+                std::string rest;
+                unsigned threshold = 0;
+                size_t budget = 4096;
+                std::getline(std::cin, rest);
+                std::istringstream opts(rest);
+                opts >> threshold >> budget;
+                CompactionMode mode;
+                if (parse_compaction_mode(policy, mode)) mm.setCompaction(mode, threshold, budget);
+                else std::cout << "Unknown compaction mode\n";
+            }
         }
 
        else if (cmd == "malloc") {
@@ -66,6 +346,7 @@ int main() {
         std::cin >> size;
         int id = mm.malloc_block(size);
 
+        if (quiet) continue;
         if (id == -1)
             std::cout << "Allocation failed\n";
         else
@@ -76,12 +357,19 @@ int main() {
         else if (cmd == "free") {
             int id;
             std::cin >> id;
-            if (mm.free_block(id))
+            bool ok = mm.free_block(id);
+            if (quiet) continue;
+            if (ok)
                 std::cout << "Block " << id << " freed and coalesced if possible\n";
             else
                 std::cout << "Invalid block id\n";
         }
 
+        else if (cmd == "compact") {
+            mm.compact();
+            if (!quiet) std::cout << "Heap compacted\n";
+        }
+
         else if (cmd == "dump") {
             std::string sub;
             std::cin >> sub;
@@ -100,7 +388,28 @@ int main() {
         else if (cmd == "access") {
             size_t address;
             std::cin >> address;
-            cache.access(address);  
+            std::string rest, mode;
+            std::getline(std::cin, rest);
+            std::istringstream opts(rest);
+            opts >> mode;
+            cache.access(address, mode == "w" || mode == "write");
+        }
+
+        else if (cmd == "touch" || cmd == "buddy_touch" || cmd == "slab_touch") {
+            int id;
+            size_t offset;
+            std::cin >> id >> offset;
+            std::string rest, mode;
+            std::getline(std::cin, rest);
+            std::istringstream opts(rest);
+            opts >> mode;
+            TraceOp op = cmd == "touch" ? TraceOp::TOUCH : cmd == "buddy_touch" ? TraceOp::BUDDY_TOUCH : TraceOp::SLAB_TOUCH;
+            uint64_t address;
+            if (!resolve_touch(mm, ba, slab, op, id, offset, address)) {
+                std::cout << "Invalid block ID or offset\n";
+                continue;
+            }
+            cache.access(address, mode == "w" || mode == "write");
         }
 
         else if (cmd == "cache") {
@@ -108,33 +417,301 @@ int main() {
             std::cin >> sub;
             if (sub == "dump") cache.dump();
             else if (sub == "stats") cache.stats();
+            else if (sub == "replay") {
+                std::string path, rest;
+                size_t threads = 0;
+                std::cin >> path;
+                std::getline(std::cin, rest);
+                std::istringstream opts(rest);
+                opts >> threads;
+                replay_cache_sharded(path, cache.config(), threads);
+            }
+            else if (sub == "config") {
+                std::string rest, token, err;
+                std::getline(std::cin, rest);
+                std::istringstream opts(rest);
+                std::vector<std::string> tokens;
+                while (opts >> token) tokens.push_back(token);
+                HierarchyConfig config;
+                if (!parse_hierarchy_config(tokens, config, err))
+                    std::cout << "Invalid cache config: " << err << "\n";
+                else {
+                    bool classify = cache.level(0).classifiesMisses();
+                    cache = MultiLevelCache(config);
+                    cache.setMissClassification(classify);
+                    if (!quiet) std::cout << "Cache hierarchy configured with " << config.levels.size() << " levels\n";
+                }
+            }
+            else if (sub == "classify") {
+                std::string mode;
+                std::cin >> mode;
+                cache.setMissClassification(mode == "on");
+            }
         }
        else if (cmd == "buddy_init") {
         size_t size;
         std::cin >> size;
+        std::string rest, engine_name;
+        std::getline(std::cin, rest);
+        std::istringstream opts(rest);
+        size_t min_block = 1;
+        opts >> engine_name >> min_block;
+
+        BuddyEngine engine = BuddyEngine::FREE_LIST;
+        if (engine_name == "bitmap") engine = BuddyEngine::BITMAP;
+        else if (!engine_name.empty() && engine_name != "free_list")
+            std::cout << "Unknown buddy engine, using free_list\n";
+
+        delete slab;
+        slab = nullptr;
+        delete vm;
+        vm = nullptr;
         if (ba) delete ba;
-        ba = new BuddyAllocator(size);
+        ba = new BuddyAllocator(size, engine, min_block);
         std::cout << "Buddy allocator initialized with " << size << " bytes\n";
     }
     else if (cmd == "buddy_malloc") {
         size_t size;
         std::cin >> size;
         if (!ba) std::cout << "Buddy allocator not initialized!\n";
-        else ba->allocate(size);
+        else {
+            BuddyResult res = ba->allocate(size);
+            if (quiet) continue;
+            if (!res.ok())
+                std::cout << "Buddy allocation failed\n";
+            else
+                std::cout << "Allocated buddy block id=" << res.id
+                          << " at address 0x" << std::hex << res.address << std::dec << "\n";
+        }
     }
     else if (cmd == "buddy_free") {
         int id;
         std::cin >> id;
         if (!ba) std::cout << "Buddy allocator not initialized!\n";
-        else ba->freeBlock(id);
+        else {
+            BuddyResult res = ba->freeBlock(id);
+            if (quiet) continue;
+            if (!res.ok())
+                std::cout << "Invalid buddy block ID\n";
+            else
+                std::cout << "Buddy block " << id << " freed and merged\n";
+        }
     }
     else if (cmd == "buddy_dump") {
         if (!ba) std::cout << "Buddy allocator not initialized!\n";
         else ba->dump();
     }
+    else if (cmd == "slab_init") {
+        std::string rest;
+        size_t slab_size = 4096;
+        std::getline(std::cin, rest);
+        std::istringstream opts(rest);
+        opts >> slab_size;
+        if (!ba) std::cout << "Buddy allocator not initialized!\n";
+        else {
+            delete slab;
+            slab = new SlabAllocator(*ba, slab_size);
+            if (quiet) continue;
+            std::cout << "Slab allocator initialized with " << slab->slabSize() << "-byte slabs\n";
+        }
+    }
+    else if (cmd == "slab_malloc") {
+        size_t size;
+        std::cin >> size;
+        if (!slab) std::cout << "Slab allocator not initialized!\n";
+        else {
+            SlabResult res = slab->allocate(size);
+            if (quiet) continue;
+            if (!res.ok())
+                std::cout << "Slab allocation failed\n";
+            else
+                std::cout << "Allocated slab object id=" << res.id << " at address 0x" << std::hex << res.address
+                          << std::dec << (res.large ? " (buddy block " : " (class ") << res.object_size << ")\n";
+        }
+    }
+    else if (cmd == "slab_free") {
+        int id;
+        std::cin >> id;
+        if (!slab) std::cout << "Slab allocator not initialized!\n";
+        else {
+            bool ok = slab->freeObject(id);
+            if (quiet) continue;
+            if (!ok) std::cout << "Invalid slab object ID\n";
+            else std::cout << "Slab object " << id << " freed\n";
+        }
+    }
+    else if (cmd == "slab_stats") {
+        if (!slab) std::cout << "Slab allocator not initialized!\n";
+        else slab->stats();
+    }
+
+    else if (cmd == "vm_init") {
+        std::string rest, policy;
+        TlbConfig tlb;
+        std::getline(std::cin, rest);
+        std::istringstream opts(rest);
+        opts >> tlb.entries >> tlb.assoc >> policy;
+        if (!ba) std::cout << "Buddy allocator not initialized!\n";
+        else if (!policy.empty() && !parse_policy(policy, tlb.policy)) std::cout << "Unknown TLB policy\n";
+        else if (!tlb.valid())
+            std::cout << "TLB needs 1 to " << TlbConfig::MAX_ENTRIES << " entries and 1 to " << Cache::MAX_WAYS
+                      << " ways\n";
+        else {
+            delete vm;
+            vm = new VirtualMemory(*ba, tlb);
+            if (quiet) continue;
+            std::cout << "Virtual memory initialized with a " << tlb.entries << "-entry TLB\n";
+        }
+    }
+    else if (cmd == "vm_create") {
+        std::string rest;
+        uint64_t page_size = 4096;
+        std::getline(std::cin, rest);
+        std::istringstream opts(rest);
+        opts >> page_size;
+        if (!vm) std::cout << "Virtual memory not initialized!\n";
+        else {
+            int pid = vm->createProcess(page_size);
+            if (pid == -1) std::cout << "Unsupported page size\n";
+            else if (!quiet) std::cout << "Created process pid=" << pid << " with " << page_size << "-byte pages\n";
+        }
+    }
+    else if (cmd == "vm_access") {
+        int pid;
+        uint64_t vaddr;
+        std::cin >> pid >> vaddr;
+        std::string rest, mode;
+        std::getline(std::cin, rest);
+        std::istringstream opts(rest);
+        opts >> mode;
+        bool write = mode == "w" || mode == "write";
+        if (!vm) std::cout << "Virtual memory not initialized!\n";
+        else {
+            uint64_t paddr;
+            VmStatus st = vm->translate(pid, vaddr, write, paddr);
+            if (st == VmStatus::INVALID) std::cout << "Invalid process ID or address\n";
+            else if (st == VmStatus::NO_FRAME) std::cout << "Page fault failed: no free frame\n";
+            else {
+                cache.access(paddr, write);
+                if (quiet) continue;
+                std::cout << "pid " << pid << " 0x" << std::hex << vaddr << " -> 0x" << paddr << std::dec << "\n";
+            }
+        }
+    }
+    else if (cmd == "vm_paging") {
+        size_t frames;
+        std::string policy, rest;
+        uint64_t window = 1024;
+        std::cin >> frames >> policy;
+        std::getline(std::cin, rest);
+        std::istringstream opts(rest);
+        opts >> window;
+        PagePolicy p;
+        if (!vm) std::cout << "Virtual memory not initialized!\n";
+        else if (!parse_page_policy(policy, p)) std::cout << "Unknown page replacement policy\n";
+        else if (p == PagePolicy::OPT) std::cout << "OPT needs the future reference string: use it through replay\n";
+        else {
+            vm->configurePaging(frames, p, window);
+            if (quiet) continue;
+            std::cout << "Demand paging: " << frames << " frames, " << page_policy_name(p) << " replacement\n";
+        }
+    }
+    else if (cmd == "vm_destroy") {
+        int pid;
+        std::cin >> pid;
+        if (!vm) std::cout << "Virtual memory not initialized!\n";
+        else if (!vm->destroyProcess(pid)) std::cout << "Invalid process ID\n";
+        else if (!quiet) std::cout << "Process " << pid << " destroyed, frames returned to buddy\n";
+    }
+    else if (cmd == "vm_stats") {
+        if (!vm) std::cout << "Virtual memory not initialized!\n";
+        else vm->stats();
+    }
+
+        else if (cmd == "replay") {
+            std::string path;
+            std::cin >> path;
+            ReplaySummary summary;
+            replay_file(path, mm, ba, slab, vm, cache, summary);
+        }
+
+        else if (cmd == "save") {
+            std::string path, err;
+            std::cin >> path;
+            uint64_t bytes = 0;
+            if (!save_simulator_image(path, mm, ba, cache, bytes, err)) std::cout << "Save failed: " << err << "\n";
+            else if (!quiet) std::cout << "Saved " << bytes << " bytes to " << path << "\n";
+        }
+
+        else if (cmd == "load") {
+            std::string path;
+            std::cin >> path;
+            if (load_image_file(path, mm, ba, slab, vm, cache) && !quiet) std::cout << "Loaded " << path << "\n";
+        }
+
+        else if (cmd == "mrc") {
+            std::string path, rest;
+            size_t block_size = 64;
+            double rate = 1.0;
+            std::cin >> path >> block_size;
+            std::getline(std::cin, rest);
+            std::istringstream opts(rest);
+            opts >> rate;
+            profile_trace(path, block_size, rate);
+        }
+
+        else if (cmd == "sweep") {
+            std::string grid_path, trace_path, rest;
+            size_t threads = 0;
+            std::cin >> grid_path >> trace_path;
+            std::getline(std::cin, rest);
+            std::istringstream opts(rest);
+            opts >> threads;
+            sweep_files(grid_path, trace_path, threads);
+        }
+
+        else if (cmd == "mt_replay") {
+            std::string rest, path;
+            size_t threads = 0, heap_size = 0;
+            std::getline(std::cin, rest);
+            std::istringstream opts(rest);
+            opts >> threads >> heap_size;
+            std::vector<std::string> paths;
+            while (opts >> path) paths.push_back(path);
+            concurrent_replay(threads, heap_size, paths);
+        }
+
+        else if (cmd == "telemetry") {
+            std::string path, rest;
+            uint64_t interval = 100;
+            std::cin >> path;
+            std::getline(std::cin, rest);
+            std::istringstream opts(rest);
+            opts >> interval;
+            stop_telemetry(telemetry, mm);
+            if (path != "off" && start_telemetry(telemetry, mm, path, interval) && !quiet)
+                std::cout << "Sampling fragmentation every " << interval << " ops into " << path << "\n";
+        }
+
+        else if (cmd == "profile") {
+            std::string rest, sub;
+            std::getline(std::cin, rest);
+            std::istringstream opts(rest);
+            opts >> sub;
+            if (sub == "reset") profile_reset();
+            else if (!profile_report())
+                std::cout << "Profiling not compiled in; rebuild with CXXFLAGS=-DMEMSIM_PROFILE\n";
+        }
+
+        else if (cmd == "quiet") {
+            std::string mode;
+            std::cin >> mode;
+            quiet = (mode == "on");
+        }
 
         else if (cmd == "exit") {
             break;
         }
     }
+    stop_telemetry(telemetry, mm);
 }
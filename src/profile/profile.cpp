@@ -0,0 +1,153 @@
+#include "profile.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+void LogHistogram::merge(const LogHistogram &o) {
+    for (size_t b = 0; b < BUCKETS; b++) counts[b] += o.counts[b];
+    total += o.total;
+    if (o.max_seen > max_seen) max_seen = o.max_seen;
+}
+
+void LogHistogram::clear() { *this = LogHistogram(); }
+
+uint64_t LogHistogram::upper(size_t b) {
+    if (b < SUB) return b;
+    unsigned e = (unsigned)(b / SUB) + SUB_BITS - 1;
+    uint64_t lower = ((uint64_t)1 << e) | ((uint64_t)(b % SUB) << (e - SUB_BITS));
+    return lower + ((uint64_t)1 << (e - SUB_BITS)) - 1;
+}
+
+uint64_t LogHistogram::percentile(double q) const {
+    if (!total) return 0;
+    uint64_t need = (uint64_t)std::ceil(q * total);
+    if (need == 0) need = 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= need) return upper(b) < max_seen ? upper(b) : max_seen;
+    }
+    return max_seen;
+}
+
+uint64_t profile_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+const char *profile_tick_unit() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+namespace {
+
+struct ProfileData {
+    LogHistogram ops[(size_t)ProfOp::COUNT];
+    LogHistogram counters[(size_t)ProfCounter::COUNT];
+
+    void merge(const ProfileData &o) {
+        for (size_t i = 0; i < (size_t)ProfOp::COUNT; i++) ops[i].merge(o.ops[i]);
+        for (size_t i = 0; i < (size_t)ProfCounter::COUNT; i++) counters[i].merge(o.counters[i]);
+    }
+};
+
+// Threads record into their own ProfileData; a thread that exits folds its
+// samples into `retired`, so worker-pool runs are not lost.
+struct Registry {
+    std::mutex lock;
+    std::vector<ProfileData *> live;
+    ProfileData retired;
+};
+
+Registry &registry() {
+    static Registry *r = new Registry;   // outlives every thread_local
+    return *r;
+}
+
+struct ThreadProfile {
+    ProfileData data;
+    ThreadProfile() {
+        std::lock_guard<std::mutex> g(registry().lock);
+        registry().live.push_back(&data);
+    }
+    ~ThreadProfile() {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> g(r.lock);
+        r.retired.merge(data);
+        for (size_t i = 0; i < r.live.size(); i++)
+            if (r.live[i] == &data) {
+                r.live[i] = r.live.back();
+                r.live.pop_back();
+                break;
+            }
+    }
+};
+
+ProfileData &local() {
+    static thread_local ThreadProfile t;
+    return t.data;
+}
+
+#ifdef MEMSIM_PROFILE
+const char *op_name(size_t i) {
+    static const char *names[] = {"malloc", "free", "buddy_alloc", "buddy_free", "cache_access", "vm_translate"};
+    return names[i];
+}
+
+const char *counter_name(size_t i) {
+    static const char *names[] = {"fit_scan", "split_depth", "merge_depth", "ways_probed"};
+    return names[i];
+}
+
+void print_row(const char *name, const LogHistogram &h) {
+    std::cout << "  " << name << ": n=" << h.count() << "  p50=" << h.percentile(0.50)
+              << "  p99=" << h.percentile(0.99) << "  p999=" << h.percentile(0.999) << "  max=" << h.max() << "\n";
+}
+#endif
+
+}  // namespace
+
+void profile_record(ProfOp op, uint64_t ticks) { local().ops[(size_t)op].record(ticks); }
+
+void profile_count(ProfCounter c, uint64_t value) { local().counters[(size_t)c].record(value); }
+
+bool profile_report() {
+#ifdef MEMSIM_PROFILE
+    Registry &r = registry();
+    ProfileData all;
+    {
+        std::lock_guard<std::mutex> g(r.lock);
+        all.merge(r.retired);
+        for (const ProfileData *d : r.live) all.merge(*d);
+    }
+    std::cout << "\n=== PROFILE (latency in " << profile_tick_unit() << ") ===\n";
+    for (size_t i = 0; i < (size_t)ProfOp::COUNT; i++)
+        if (all.ops[i].count()) print_row(op_name(i), all.ops[i]);
+    std::cout << "Counters:\n";
+    for (size_t i = 0; i < (size_t)ProfCounter::COUNT; i++)
+        if (all.counters[i].count()) print_row(counter_name(i), all.counters[i]);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void profile_reset() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> g(r.lock);
+    r.retired = ProfileData();
+    for (ProfileData *d : r.live) *d = ProfileData();
+}
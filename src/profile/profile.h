@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Hot-path instrumentation, compiled in only with -DMEMSIM_PROFILE
+// (e.g. `mingw32-make CXXFLAGS=-DMEMSIM_PROFILE`). Without it every macro
+// below expands to nothing, so the simulators carry no extra code.
+//
+//   MEMSIM_PROFILE_SCOPE(op)        time the rest of the enclosing block as `op`
+//   MEMSIM_PROFILE_COUNT(c, value)  add one sample of counter `c`
+//   MEMSIM_PROFILE_ONLY(code)       code that only exists in profiling builds
+//
+// Samples go into per-thread log-bucketed histograms (see LogHistogram), so
+// recording never takes a lock; profile_report() merges them.
+
+enum class ProfOp {
+    MALLOC,
+    FREE,
+    BUDDY_ALLOC,
+    BUDDY_FREE,
+    CACHE_ACCESS,   // one access through the whole hierarchy
+    VM_TRANSLATE,
+    COUNT
+};
+
+enum class ProfCounter {
+    FIT_SCAN,       // free blocks examined per fit search
+    SPLIT_DEPTH,    // buddy splits per allocation
+    MERGE_DEPTH,    // buddy merges per free
+    WAYS_PROBED,    // valid ways tag-compared per cache lookup
+    COUNT
+};
+
+// HDR-style histogram: values below 16 get a bucket each, larger values
+// fall into 16 linear sub-buckets per power of two, so a recorded value is
+// off by at most 1/16 (6.25%) and the whole uint64 range fits 976 buckets.
+class LogHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 4;
+    static constexpr size_t SUB = (size_t)1 << SUB_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    void record(uint64_t v) {
+        counts[bucket(v)]++;
+        total++;
+        if (v > max_seen) max_seen = v;
+    }
+    void merge(const LogHistogram &o);
+    void clear();
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return max_seen; }
+    // Smallest bucket bound covering fraction q of the samples.
+    uint64_t percentile(double q) const;
+
+    static size_t bucket(uint64_t v) {
+        if (v < SUB) return (size_t)v;
+        unsigned e = 63 - __builtin_clzll(v);   // e >= SUB_BITS
+        return (size_t)(e - SUB_BITS + 1) * SUB + ((v >> (e - SUB_BITS)) & (SUB - 1));
+    }
+    static uint64_t upper(size_t b);
+
+private:
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t max_seen = 0;
+};
+
+// Ticks for MEMSIM_PROFILE_SCOPE: TSC cycles on x86, steady_clock ns elsewhere.
+uint64_t profile_ticks();
+const char *profile_tick_unit();
+
+void profile_record(ProfOp op, uint64_t ticks);
+void profile_count(ProfCounter c, uint64_t value);
+// Prints p50/p99/p999/max per operation and counter; false when profiling
+// is not compiled in.
+bool profile_report();
+void profile_reset();
+
+#ifdef MEMSIM_PROFILE
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfOp op) : op(op), start(profile_ticks()) {}
+    ~ProfileScope() { profile_record(op, profile_ticks() - start); }
+
+private:
+    ProfOp op;
+    uint64_t start;
+};
+
+#define MEMSIM_PROFILE_CAT2(a, b) a##b
+#define MEMSIM_PROFILE_CAT(a, b) MEMSIM_PROFILE_CAT2(a, b)
+#define MEMSIM_PROFILE_SCOPE(op) ProfileScope MEMSIM_PROFILE_CAT(profile_scope_, __LINE__)(op)
+#define MEMSIM_PROFILE_COUNT(c, value) profile_count(c, value)
+#define MEMSIM_PROFILE_ONLY(...) __VA_ARGS__
+#else
+#define MEMSIM_PROFILE_SCOPE(op)
+#define MEMSIM_PROFILE_COUNT(c, value)
+#define MEMSIM_PROFILE_ONLY(...)
+#endif
@@ -0,0 +1,259 @@
+#include "slab_allocator.h"
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+constexpr uint64_t GRANULE = 16;
+
+uint64_t next_pow2(uint64_t n) {
+    uint64_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+// What the same request costs when it goes straight to the buddy allocator.
+uint64_t buddy_block_for(uint64_t request, uint64_t min_block) {
+    uint64_t p = next_pow2(request);
+    return p < min_block ? min_block : p;
+}
+
+}  // namespace
+
+SlabAllocator::SlabAllocator(BuddyAllocator &b, size_t size) : buddy(b), slab_size(size) {
+    if (slab_size < 4 * GRANULE) slab_size = 4 * GRANULE;
+    slab_size = next_pow2(slab_size);
+
+    // Classes at powers of two and halfway between (16, 32, 48, 64, 96, 128,
+    // ...), up to half a slab so every slab holds at least two objects.
+    for (uint64_t p = GRANULE; p <= slab_size / 2; p *= 2) {
+        for (uint64_t sz : {p, p + p / 2}) {
+            if (sz > slab_size / 2 || sz % GRANULE) continue;
+            if (!classes.empty() && classes.back().object_size >= sz) continue;
+            SizeClass c;
+            c.object_size = sz;
+            c.capacity = (uint32_t)(slab_size / sz);
+            classes.push_back(c);
+        }
+    }
+    class_of.resize(slab_size / 2 / GRANULE + 1);
+    size_t c = 0;
+    for (size_t g = 0; g < class_of.size(); g++) {
+        while (classes[c].object_size < g * GRANULE) c++;
+        class_of[g] = (uint8_t)c;
+    }
+    objects.push_back({FREED, 0, 0});   // ids start at 1
+}
+
+SlabAllocator::~SlabAllocator() {
+    for (const Slab &s : slabs)
+        if (s.buddy_id != -1) buddy.freeBlock(s.buddy_id);
+    for (const Object &o : objects)
+        if (o.slab == NIL) buddy.freeBlock((int)o.slot);
+}
+
+size_t SlabAllocator::classFor(uint64_t size) const {
+    if (size > classes.back().object_size) return classes.size();
+    return class_of[(size + GRANULE - 1) / GRANULE];
+}
+
+void SlabAllocator::link(uint32_t s, SlabList list) {
+    Slab &slab = slabs[s];
+    SizeClass &c = classes[slab.cls];
+    slab.list = list;
+    slab.prev = NIL;
+    slab.next = c.heads[list];
+    if (slab.next != NIL) slabs[slab.next].prev = s;
+    c.heads[list] = s;
+    c.counts[list]++;
+}
+
+void SlabAllocator::unlink(uint32_t s) {
+    Slab &slab = slabs[s];
+    SizeClass &c = classes[slab.cls];
+    if (slab.prev != NIL) slabs[slab.prev].next = slab.next;
+    else c.heads[slab.list] = slab.next;
+    if (slab.next != NIL) slabs[slab.next].prev = slab.prev;
+    c.counts[slab.list]--;
+}
+
+// Takes one slab-sized block from the buddy allocator for class `cls` and
+// puts it on the empty list. Returns NIL when the buddy heap is exhausted.
+uint32_t SlabAllocator::growClass(uint32_t cls) {
+    BuddyResult page = buddy.allocate(slab_size);
+    if (!page.ok()) return NIL;
+
+    uint32_t s;
+    if (!spare_slabs.empty()) {
+        s = spare_slabs.back();
+        spare_slabs.pop_back();
+    } else {
+        s = (uint32_t)slabs.size();
+        slabs.emplace_back();
+    }
+    Slab &slab = slabs[s];
+    SizeClass &c = classes[cls];
+    slab.buddy_id = page.id;
+    slab.base = page.address;
+    slab.cls = cls;
+    slab.used = 0;
+    slab.first_word = 0;
+    slab.free_bits.assign((c.capacity + 63) / 64, ~0ULL);
+    if (c.capacity % 64) slab.free_bits.back() = (1ULL << (c.capacity % 64)) - 1;
+    c.slabs_created++;
+    link(s, EMPTY);
+    return s;
+}
+
+void SlabAllocator::releaseSlab(uint32_t s) {
+    Slab &slab = slabs[s];
+    unlink(s);
+    buddy.freeBlock(slab.buddy_id);
+    classes[slab.cls].slabs_released++;
+    slab.buddy_id = -1;
+    slab.free_bits.clear();
+    spare_slabs.push_back(s);
+}
+
+SlabResult SlabAllocator::allocate(uint64_t request_size) {
+    SlabResult res;
+    if (request_size == 0) request_size = 1;
+    size_t cls = classFor(request_size);
+
+    if (cls == classes.size()) {
+        BuddyResult big = buddy.allocate(request_size);
+        if (!big.ok()) {
+            alloc_fail++;
+            return res;
+        }
+        res.id = (int)objects.size();
+        res.address = big.address;
+        res.object_size = 1ULL << big.order;
+        res.large = true;
+        objects.push_back({NIL, (uint32_t)big.id, request_size});
+        large_live++;
+        large_requested += request_size;
+        large_bytes += res.object_size;
+        return res;
+    }
+
+    SizeClass &c = classes[cls];
+    uint32_t s = c.heads[PARTIAL];
+    if (s == NIL) {
+        s = c.heads[EMPTY];
+        if (s == NIL) s = growClass((uint32_t)cls);
+        if (s == NIL) {
+            alloc_fail++;
+            return res;
+        }
+        unlink(s);
+        link(s, PARTIAL);
+    }
+
+    Slab &slab = slabs[s];
+    while (!slab.free_bits[slab.first_word]) slab.first_word++;
+    uint64_t &word = slab.free_bits[slab.first_word];
+    uint32_t slot = slab.first_word * 64 + __builtin_ctzll(word);
+    word &= word - 1;
+    if (++slab.used == c.capacity) {
+        unlink(s);
+        link(s, FULL);
+    }
+
+    c.live++;
+    c.allocs++;
+    c.requested += request_size;
+    res.id = (int)objects.size();
+    res.address = slab.base + slot * c.object_size;
+    res.object_size = c.object_size;
+    objects.push_back({s, slot, request_size});
+    return res;
+}
+
+bool SlabAllocator::freeObject(int id) {
+    if (id <= 0 || (size_t)id >= objects.size()) return false;
+    Object &o = objects[id];
+    if (o.slab == FREED) return false;
+
+    if (o.slab == NIL) {
+        buddy.freeBlock((int)o.slot);
+        large_live--;
+        large_requested -= o.requested;
+        large_bytes -= buddy_block_for(o.requested, buddy.minBlock());
+        o.slab = FREED;
+        return true;
+    }
+
+    uint32_t s = o.slab;
+    Slab &slab = slabs[s];
+    SizeClass &c = classes[slab.cls];
+    slab.free_bits[o.slot / 64] |= 1ULL << (o.slot % 64);
+    if (o.slot / 64 < slab.first_word) slab.first_word = o.slot / 64;
+
+    if (slab.used-- == c.capacity) {
+        unlink(s);
+        link(s, PARTIAL);
+    }
+    if (slab.used == 0) {
+        // Keep a few empty slabs per class so alloc/free at a boundary does
+        // not bounce pages through the buddy allocator.
+        if (c.counts[EMPTY] < KEEP_EMPTY) {
+            unlink(s);
+            link(s, EMPTY);
+        } else {
+            releaseSlab(s);
+        }
+    }
+
+    c.live--;
+    c.frees++;
+    c.requested -= o.requested;
+    o.slab = FREED;
+    return true;
+}
+
+bool SlabAllocator::objectExtent(int id, uint64_t &address, uint64_t &size) const {
+    if (id <= 0 || (size_t)id >= objects.size()) return false;
+    const Object &o = objects[id];
+    if (o.slab == FREED) return false;
+    if (o.slab == NIL) return buddy.blockExtent((int)o.slot, address, size);
+    const Slab &slab = slabs[o.slab];
+    size = classes[slab.cls].object_size;
+    address = slab.base + o.slot * size;
+    return true;
+}
+
+void SlabAllocator::stats() const {
+    std::cout << "\n=== SLAB ALLOCATOR STATS ===\n";
+    std::cout << "Slab size: " << slab_size << " bytes\n";
+    std::cout << std::left << std::setw(8) << "Class" << std::setw(14) << "Slabs P/F/E"
+              << std::setw(14) << "Objects" << std::setw(12) << "Requested"
+              << std::setw(16) << "Internal frag" << "Slab waste\n";
+
+    uint64_t slab_frag = 0, buddy_frag = 0, slab_waste = 0;
+    for (const SizeClass &c : classes) {
+        uint32_t nslabs = c.counts[PARTIAL] + c.counts[FULL] + c.counts[EMPTY];
+        if (!nslabs && !c.allocs) continue;
+        uint64_t frag = c.live * c.object_size - c.requested;
+        uint64_t waste = (uint64_t)nslabs * slab_size - c.live * c.object_size;
+        slab_frag += frag;
+        slab_waste += waste;
+
+        std::string counts = std::to_string(c.counts[PARTIAL]) + "/" + std::to_string(c.counts[FULL]) + "/" +
+                             std::to_string(c.counts[EMPTY]);
+        std::string objs = std::to_string(c.live) + "/" + std::to_string((uint64_t)nslabs * c.capacity);
+        std::cout << std::setw(8) << c.object_size << std::setw(14) << counts << std::setw(14) << objs
+                  << std::setw(12) << c.requested << std::setw(16) << frag << waste << "\n";
+    }
+    std::cout << std::right;
+
+    for (const Object &o : objects)
+        if (o.slab != FREED) buddy_frag += buddy_block_for(o.requested, buddy.minBlock()) - o.requested;
+
+    std::cout << "Large objects (direct buddy): " << large_live << "  requested " << large_requested
+              << "  internal frag " << large_bytes - large_requested << "\n";
+    std::cout << "Internal fragmentation: " << slab_frag + large_bytes - large_requested
+              << " bytes (raw buddy: " << buddy_frag << " bytes)\n";
+    std::cout << "Unused slab space: " << slab_waste << " bytes\n";
+    std::cout << "Failed allocations: " << alloc_fail << "\n";
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../buddy/buddy_allocator.h"
+
+// Outcome of one SlabAllocator::allocate. object_size is the size class the
+// request landed in, or the buddy block size for requests too large for any
+// class.
+struct SlabResult {
+    int id = -1;
+    uint64_t address = 0;
+    uint64_t object_size = 0;
+    bool large = false;
+
+    bool ok() const { return id != -1; }
+};
+
+// Size-class front end over a BuddyAllocator. Each class keeps a cache of
+// slabs, one buddy block of slab_size bytes each, carved into equal objects
+// and tracked with a free bitmap. Slabs move between partial, full and empty
+// lists as objects come and go, so an allocation takes the head of the
+// partial list and a bit scan. Requests above the largest class go to the
+// buddy allocator directly.
+class SlabAllocator {
+public:
+    explicit SlabAllocator(BuddyAllocator &buddy, size_t slab_size = 4096);
+    ~SlabAllocator();   // returns every slab and large block to the buddy allocator
+    SlabAllocator(const SlabAllocator &) = delete;
+    SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+    SlabResult allocate(uint64_t request_size);
+    bool freeObject(int id);
+    // Address and object size (class or buddy block) of a live object.
+    bool objectExtent(int id, uint64_t &address, uint64_t &size) const;
+    void stats() const;
+
+    size_t slabSize() const { return slab_size; }
+
+private:
+    enum SlabList : uint8_t { PARTIAL, FULL, EMPTY };
+    static constexpr uint32_t NIL = UINT32_MAX;
+    static constexpr size_t KEEP_EMPTY = 1;   // empty slabs cached per class
+
+    struct Slab {
+        int buddy_id = -1;
+        uint64_t base = 0;
+        uint32_t cls = 0;
+        uint32_t used = 0;
+        uint32_t first_word = 0;   // no free bit below this bitmap word
+        uint32_t prev = NIL, next = NIL;
+        SlabList list = EMPTY;
+        std::vector<uint64_t> free_bits;   // 1 = free slot
+    };
+
+    struct SizeClass {
+        uint64_t object_size = 0;
+        uint32_t capacity = 0;   // objects per slab
+        uint32_t heads[3] = {NIL, NIL, NIL};
+        uint32_t counts[3] = {0, 0, 0};
+        uint64_t live = 0;
+        uint64_t requested = 0;   // bytes asked for by live objects
+        uint64_t allocs = 0, frees = 0;
+        uint64_t slabs_created = 0, slabs_released = 0;
+    };
+
+    // id -> object; slab == NIL marks a large (direct buddy) object, whose
+    // slot holds the buddy id; slab == FREED once the object is freed.
+    static constexpr uint32_t FREED = NIL - 1;
+    struct Object {
+        uint32_t slab;
+        uint32_t slot;
+        uint64_t requested;
+    };
+
+    BuddyAllocator &buddy;
+    size_t slab_size;
+    std::vector<SizeClass> classes;
+    std::vector<uint8_t> class_of;   // 16-byte granule count -> class
+    std::vector<Slab> slabs;
+    std::vector<uint32_t> spare_slabs;   // recycled indices into slabs
+    std::vector<Object> objects;
+    uint64_t large_live = 0, large_requested = 0, large_bytes = 0;
+    uint64_t alloc_fail = 0;
+
+    size_t classFor(uint64_t size) const;
+    uint32_t growClass(uint32_t cls);
+    void releaseSlab(uint32_t s);
+    void link(uint32_t s, SlabList list);
+    void unlink(uint32_t s);
+};
@@ -0,0 +1,235 @@
+#include "snapshot.h"
+#include <cstdio>
+#include <memory>
+#include "../allocator/memory_manager.h"
+#include "../buddy/buddy_allocator.h"
+#include "../cache/multilevel_cache.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct ImageHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t layout;
+    uint32_t sections;
+    uint64_t bytes;
+    uint64_t checksum;   // over everything after the header
+};
+static_assert(sizeof(ImageHeader) == 32, "image header must stay 32 bytes");
+static_assert(sizeof(ImageSection) == 40, "image table entries must stay 40 bytes");
+
+const char IMAGE_MAGIC[4] = {'M', 'S', 'I', 'M'};
+
+// Struct sizes and byte order the raw sections depend on.
+uint32_t image_layout() {
+    const uint16_t probe = 1;
+    uint32_t little = *reinterpret_cast<const uint8_t *>(&probe);
+    return (uint32_t)sizeof(Block) | (uint32_t)sizeof(BuddyBlock) << 8 | (uint32_t)sizeof(size_t) << 16 |
+           (little ? 1u : 2u) << 24;
+}
+
+uint64_t align8(uint64_t n) {
+    return (n + 7) & ~(uint64_t)7;
+}
+
+// Word-at-a-time multiply/rotate hash; every part of the image is a whole
+// number of 8-byte words, so it can be fed piecewise while writing.
+class ImageChecksum {
+public:
+    void add(const void *data, size_t bytes) {
+        const char *p = static_cast<const char *>(data);
+        for (size_t i = 0; i + 8 <= bytes; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, p + i, 8);
+            h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+            h ^= h >> 29;
+        }
+        if (bytes % 8) {
+            uint64_t w = 0;
+            std::memcpy(&w, p + bytes - bytes % 8, bytes % 8);
+            h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+            h ^= h >> 29;
+        }
+    }
+    uint64_t value() const { return h; }
+
+private:
+    uint64_t h = 0xcbf29ce484222325ULL;
+};
+
+}  // namespace
+
+bool ImageWriter::write(const std::string &path, uint64_t &bytes, std::string &err) const {
+    std::vector<ImageSection> table(sections.size());
+    uint64_t offset = align8(sizeof(ImageHeader) + table.size() * sizeof(ImageSection));
+    for (size_t i = 0; i < sections.size(); i++) {
+        if (sections[i].name.size() >= sizeof(table[i].name)) {
+            err = "section name too long: " + sections[i].name;
+            return false;
+        }
+        std::memset(table[i].name, 0, sizeof(table[i].name));
+        std::memcpy(table[i].name, sections[i].name.data(), sections[i].name.size());
+        table[i].offset = offset;
+        table[i].bytes = sections[i].bytes;
+        offset = align8(offset + sections[i].bytes);
+    }
+
+    ImageHeader h;
+    std::memcpy(h.magic, IMAGE_MAGIC, 4);
+    h.version = IMAGE_VERSION;
+    h.layout = image_layout();
+    h.sections = (uint32_t)table.size();
+    h.bytes = offset;
+
+    // Section padding is zeros, which add() folds into each partial word,
+    // so this matches a checksum of the finished file.
+    ImageChecksum sum;
+    sum.add(table.data(), table.size() * sizeof(ImageSection));
+    for (const Pending &p : sections) sum.add(p.data ? p.data : p.owned.data(), p.bytes);
+    h.checksum = sum.value();
+
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> fp(std::fopen(path.c_str(), "wb"), std::fclose);
+    if (!fp) {
+        err = "cannot create " + path;
+        return false;
+    }
+    static const char zeros[8] = {};
+    uint64_t at = sizeof(h) + table.size() * sizeof(ImageSection);
+    bool ok = std::fwrite(&h, sizeof(h), 1, fp.get()) == 1 &&
+              std::fwrite(table.data(), sizeof(ImageSection), table.size(), fp.get()) == table.size();
+    for (size_t i = 0; ok && i < sections.size(); i++) {
+        ok = std::fwrite(zeros, 1, table[i].offset - at, fp.get()) == table[i].offset - at;
+        const void *data = sections[i].data ? sections[i].data : sections[i].owned.data();
+        ok = ok && std::fwrite(data, 1, sections[i].bytes, fp.get()) == sections[i].bytes;
+        at = table[i].offset + sections[i].bytes;
+    }
+    ok = ok && std::fwrite(zeros, 1, offset - at, fp.get()) == offset - at;
+    ok = std::fclose(fp.release()) == 0 && ok;
+    if (!ok) {
+        err = "write error on " + path;
+        return false;
+    }
+    bytes = offset;
+    return true;
+}
+
+ImageFile::~ImageFile() {
+#ifndef _WIN32
+    if (mapping) munmap(mapping, length);
+#endif
+}
+
+bool ImageFile::open(const std::string &path, std::string &err) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ImageHeader)) {
+        ::close(fd);
+        err = "cannot read " + path;
+        return false;
+    }
+    length = (size_t)st.st_size;
+    mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        err = "cannot map " + path;
+        return false;
+    }
+    base = static_cast<const char *>(mapping);
+#else
+    std::FILE *fp = std::fopen(path.c_str(), "rb");
+    if (!fp) {
+        err = "cannot open " + path;
+        return false;
+    }
+    std::fseek(fp, 0, SEEK_END);
+    length = (size_t)std::ftell(fp);
+    std::fseek(fp, 0, SEEK_SET);
+    // operator new storage is aligned well enough for the 8-byte sections
+    buffer.resize(length);
+    size_t got = std::fread(buffer.data(), 1, length, fp);
+    std::fclose(fp);
+    if (got != length || length < sizeof(ImageHeader)) {
+        err = "cannot read " + path;
+        return false;
+    }
+    base = buffer.data();
+#endif
+    return check(err);
+}
+
+bool ImageFile::check(std::string &err) {
+    ImageHeader h;
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, IMAGE_MAGIC, 4) != 0) {
+        err = "not a memsim image";
+        return false;
+    }
+    if (h.version != IMAGE_VERSION) {
+        err = "unsupported image version " + std::to_string(h.version);
+        return false;
+    }
+    if (h.layout != image_layout()) {
+        err = "image was written by a build with a different memory layout";
+        return false;
+    }
+    if (h.bytes > length || h.bytes < sizeof(h) || h.sections > (length - sizeof(h)) / sizeof(ImageSection)) {
+        err = "image is truncated";
+        return false;
+    }
+    ImageChecksum sum;
+    sum.add(base + sizeof(h), h.bytes - sizeof(h));
+    if (sum.value() != h.checksum) {
+        err = "image checksum mismatch";
+        return false;
+    }
+    table = reinterpret_cast<const ImageSection *>(base + sizeof(h));
+    count = h.sections;
+    for (uint32_t i = 0; i < count; i++)
+        if (table[i].offset % 8 || table[i].offset > length || table[i].bytes > length - table[i].offset) {
+            err = "image is truncated";
+            return false;
+        }
+    return true;
+}
+
+bool save_simulator_image(const std::string &path, const MemoryManagerSimulator &mm, const BuddyAllocator *ba,
+                          const MultiLevelCache &cache, uint64_t &bytes, std::string &err) {
+    ImageWriter img;
+    mm.save_image(img);
+    if (ba) ba->saveImage(img);
+    cache.saveImage(img);
+    return img.write(path, bytes, err);
+}
+
+bool load_simulator_image(const std::string &path, MemoryManagerSimulator &mm, MultiLevelCache &cache,
+                          BuddyAllocator *&loaded, std::string &err) {
+    ImageFile img;
+    if (!img.open(path, err)) return false;
+
+    // Everything that can fail is built on the side first; the heap checks
+    // its sections before it changes anything.
+    std::unique_ptr<BuddyAllocator> buddy;
+    if (img.has("buddy.state")) {
+        buddy.reset(BuddyAllocator::loadImage(img, err));
+        if (!buddy) return false;
+    }
+    MultiLevelCache restored(cache.config());
+    if (!restored.loadImage(img, err) || !mm.load_image(img, err)) return false;
+
+    cache = std::move(restored);
+    loaded = buddy.release();
+    return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+class MemoryManagerSimulator;
+class BuddyAllocator;
+class MultiLevelCache;
+
+// Flat simulator image: a header, a table of named sections, then every
+// section as a raw array, 8-byte aligned, in host byte order.
+//
+//   header:  "MSIM" | uint32 version | uint32 layout | uint32 sections | uint64 file bytes
+//            | uint64 checksum of everything after the header
+//   table:   sections x { char name[24] | uint64 offset | uint64 bytes }
+//
+// Each component writes its state arrays as they sit in memory (block
+// store slots, id tables, buddy bitmaps, cache tags and replacement state),
+// so loading is one bulk copy per section with no per-element parsing, and
+// an mmapped image can be read in place. `layout` fingerprints the struct
+// sizes the arrays depend on; an image only loads into a matching build.
+constexpr uint32_t IMAGE_VERSION = 1;
+
+struct ImageSection {
+    char name[24];
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+class ImageWriter {
+public:
+    // The data is referenced, not copied: it must stay alive until write().
+    void add(const std::string &name, const void *data, size_t bytes) { sections.push_back({name, data, bytes, {}}); }
+    template <typename T>
+    void add(const std::string &name, const std::vector<T> &v) { add(name, v.data(), v.size() * sizeof(T)); }
+    // Copied now, for state that is assembled just for the image.
+    void addCopy(const std::string &name, const void *data, size_t bytes) {
+        const char *p = static_cast<const char *>(data);
+        sections.push_back({name, nullptr, bytes, std::vector<char>(p, p + bytes)});
+    }
+    template <typename T>
+    void addValue(const std::string &name, const T &v) { addCopy(name, &v, sizeof(T)); }
+
+    bool write(const std::string &path, uint64_t &bytes, std::string &err) const;
+
+private:
+    struct Pending {
+        std::string name;
+        const void *data;
+        size_t bytes;
+        std::vector<char> owned;
+    };
+    std::vector<Pending> sections;
+};
+
+// Read-only view of an image: mmapped where available, otherwise read into
+// memory with one bulk read.
+class ImageFile {
+public:
+    ImageFile() = default;
+    ~ImageFile();
+    ImageFile(const ImageFile &) = delete;
+    ImageFile &operator=(const ImageFile &) = delete;
+
+    bool open(const std::string &path, std::string &err);
+    size_t size() const { return length; }
+    bool has(const std::string &name) const { return find(name) != nullptr; }
+
+    // In-place view of a section; nullptr when it is missing or its size is
+    // not a whole number of T.
+    template <typename T>
+    const T *view(const std::string &name, size_t &count) const {
+        const ImageSection *s = find(name);
+        if (!s || s->bytes % sizeof(T)) return nullptr;
+        count = s->bytes / sizeof(T);
+        return reinterpret_cast<const T *>(base + s->offset);
+    }
+    // Bulk copy of a section into `out`, resized to fit.
+    template <typename T>
+    bool read(const std::string &name, std::vector<T> &out) const {
+        size_t n = 0;
+        const T *p = view<T>(name, n);
+        if (!p) return false;
+        out.resize(n);
+        if (n) std::memcpy(out.data(), p, n * sizeof(T));
+        return true;
+    }
+    // Bulk copy into an array whose size the loader already knows; fails
+    // unless the section has exactly that many elements.
+    template <typename T>
+    bool readExact(const std::string &name, T *out, size_t count) const {
+        size_t n = 0;
+        const T *p = view<T>(name, n);
+        if (!p || n != count) return false;
+        if (n) std::memcpy(out, p, n * sizeof(T));
+        return true;
+    }
+    template <typename T>
+    bool readValue(const std::string &name, T &out) const { return readExact(name, &out, 1); }
+
+private:
+    const char *base = nullptr;
+    size_t length = 0;
+    const ImageSection *table = nullptr;
+    uint32_t count = 0;
+    void *mapping = nullptr;
+    std::vector<char> buffer;
+
+    const ImageSection *find(const std::string &name) const {
+        for (uint32_t i = 0; i < count; i++)
+            if (std::strncmp(table[i].name, name.c_str(), sizeof(table[i].name)) == 0) return &table[i];
+        return nullptr;
+    }
+    bool check(std::string &err);
+};
+
+// Writes the heap, the buddy allocator (when there is one) and the cache
+// hierarchy to `path`.
+bool save_simulator_image(const std::string &path, const MemoryManagerSimulator &mm, const BuddyAllocator *ba,
+                          const MultiLevelCache &cache, uint64_t &bytes, std::string &err);
+
+// Replaces the heap and the cache hierarchy with the image's state and
+// hands back its buddy heap in `loaded` (nullptr if the image has none) for
+// the caller to swap in once whatever sits on its old one is gone. Nothing
+// changes unless the whole image loads.
+bool load_simulator_image(const std::string &path, MemoryManagerSimulator &mm, MultiLevelCache &cache,
+                          BuddyAllocator *&loaded, std::string &err);
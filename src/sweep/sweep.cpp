@@ -0,0 +1,136 @@
+#include "sweep.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+size_t SweepGrid::size() const {
+    size_t n = 1;
+    if (!fits.empty()) n *= fits.size();
+    if (!heaps.empty()) n *= heaps.size();
+    if (!buddies.empty()) n *= buddies.size();
+    if (!caches.empty()) n *= caches.size();
+    return n;
+}
+
+bool parse_sweep_grid(std::istream &in, SweepGrid &grid, std::string &err) {
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream ss(line);
+        std::string key, value;
+        if (!(ss >> key)) continue;
+        std::string where = "line " + std::to_string(line_no) + ": ";
+
+        if (key == "fit") {
+            AllocatorType type;
+            while (ss >> value) {
+                if (!parse_allocator_type(value, type)) {
+                    err = where + "unknown fit '" + value + "'";
+                    return false;
+                }
+                grid.fits.push_back(type);
+            }
+        } else if (key == "heap" || key == "buddy") {
+            size_t n;
+            while (ss >> n) {
+                if (n == 0 || (key == "buddy" && (n & (n - 1)) != 0)) {
+                    err = where + key + " sizes must be non-zero" + (key == "buddy" ? " powers of two" : "");
+                    return false;
+                }
+                (key == "heap" ? grid.heaps : grid.buddies).push_back(n);
+            }
+            if (!ss.eof()) {
+                err = where + "bad " + key + " size";
+                return false;
+            }
+        } else if (key == "cache") {
+            std::vector<std::string> tokens;
+            std::string spec;
+            while (ss >> value) {
+                tokens.push_back(value);
+                spec += (spec.empty() ? "" : " ") + value;
+            }
+            HierarchyConfig config;
+            std::string cache_err;
+            if (!parse_hierarchy_config(tokens, config, cache_err)) {
+                err = where + cache_err;
+                return false;
+            }
+            grid.cache_specs.push_back(spec);
+            grid.caches.push_back(config);
+        } else {
+            err = where + "unknown key '" + key + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+static SweepResult run_one(const SweepGrid &grid, size_t index, const TraceFile &trace) {
+    // Decode the job index into one value per dimension, caches fastest.
+    size_t fit = 0, heap = 0, buddy = 0, cache = 0;
+    if (!grid.caches.empty()) { cache = index % grid.caches.size(); index /= grid.caches.size(); }
+    if (!grid.buddies.empty()) { buddy = index % grid.buddies.size(); index /= grid.buddies.size(); }
+    if (!grid.heaps.empty()) { heap = index % grid.heaps.size(); index /= grid.heaps.size(); }
+    if (!grid.fits.empty()) fit = index % grid.fits.size();
+
+    SweepResult res;
+    MemoryManagerSimulator mm;
+    BuddyAllocator *ba = nullptr;
+    MultiLevelCache hierarchy(grid.caches.empty() ? default_hierarchy() : grid.caches[cache]);
+    TraceReplayer replayer(mm, ba, hierarchy);
+
+    res.fit = grid.fits.empty() ? "trace" : allocator_name(grid.fits[fit]);
+    res.cache = grid.caches.empty() ? "default" : grid.cache_specs[cache];
+    if (!grid.heaps.empty()) {
+        res.heap = grid.heaps[heap];
+        mm.init(res.heap);
+        replayer.ignore(TraceOp::INIT_MEMORY);
+    }
+    if (!grid.fits.empty()) {
+        mm.setAllocator(grid.fits[fit]);
+        replayer.ignore(TraceOp::SET_ALLOCATOR);
+    }
+    if (!grid.buddies.empty()) {
+        res.buddy = grid.buddies[buddy];
+        ba = new BuddyAllocator(res.buddy);
+        replayer.ignore(TraceOp::BUDDY_INIT);
+    }
+
+    res.replay = replayer.run(trace.begin(), trace.end());
+    res.memory = mm.snapshot();
+    if (ba) res.buddy_stats = ba->snapshot();
+    res.l1_hit_ratio = hierarchy.level(0).counters().hit_ratio();
+    res.llc_hit_ratio = hierarchy.level(hierarchy.numLevels() - 1).counters().hit_ratio();
+    res.memory_reads = hierarchy.memoryReads();
+    res.memory_writes = hierarchy.memoryWrites();
+    delete ba;
+    return res;
+}
+
+std::vector<SweepResult> run_sweep(const SweepGrid &grid, const TraceFile &trace, size_t threads) {
+    std::vector<SweepResult> results(grid.size());
+    WorkStealingPool pool(std::min(threads, results.size()));
+    pool.run(results.size(), [&](size_t i) { results[i] = run_one(grid, i, trace); });
+    return results;
+}
+
+void print_sweep_csv(const std::vector<SweepResult> &results) {
+    std::cout << "fit,heap,buddy,cache,alloc_success,alloc_fail,utilization,external_frag,internal_frag,"
+                 "buddy_success,buddy_fail,buddy_utilization,l1_hit_ratio,llc_hit_ratio,"
+                 "memory_reads,memory_writes,failed_ops,seconds\n";
+    for (const SweepResult &r : results) {
+        std::cout << r.fit << ',' << r.heap << ',' << r.buddy << ",\"" << r.cache << "\","
+                  << r.memory.alloc_success << ',' << r.memory.alloc_fail << ','
+                  << r.memory.utilization() << ',' << r.memory.external_frag() << ','
+                  << r.memory.internal_frag << ','
+                  << r.buddy_stats.alloc_success << ',' << r.buddy_stats.alloc_fail << ','
+                  << r.buddy_stats.utilization() << ','
+                  << r.l1_hit_ratio << ',' << r.llc_hit_ratio << ','
+                  << r.memory_reads << ',' << r.memory_writes << ','
+                  << r.replay.failures << ',' << r.replay.seconds << '\n';
+    }
+}
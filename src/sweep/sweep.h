@@ -0,0 +1,52 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+#include "../allocator/memory_manager.h"
+#include "../buddy/buddy_allocator.h"
+#include "../cache/multilevel_cache.h"
+#include "../trace/trace.h"
+
+// Grid of configurations, one value list per dimension. A dimension left
+// out of the grid file is not pinned: the trace's own init/set/buddy_init
+// records (or the default cache hierarchy) apply instead.
+//
+// Grid file, one dimension per line ('#' starts a comment):
+//   fit    first_fit best_fit worst_fit next_fit tlsf
+//   heap   65536 1048576
+//   buddy  65536 1048576
+//   cache  256:64:1:fifo 1024:64:4:lru nine        (one hierarchy per line)
+struct SweepGrid {
+    std::vector<AllocatorType> fits;
+    std::vector<size_t> heaps;
+    std::vector<size_t> buddies;
+    std::vector<std::string> cache_specs;
+    std::vector<HierarchyConfig> caches;
+
+    size_t size() const;
+};
+
+bool parse_sweep_grid(std::istream &in, SweepGrid &grid, std::string &err);
+
+struct SweepResult {
+    std::string fit, cache;
+    size_t heap = 0, buddy = 0;
+    MemoryStats memory;
+    BuddyStats buddy_stats;
+    double l1_hit_ratio = 0.0;
+    double llc_hit_ratio = 0.0;
+    uint64_t memory_reads = 0, memory_writes = 0;
+    ReplaySummary replay;
+};
+
+// Runs every configuration of the grid against one shared, read-only trace
+// on `threads` workers. Each job owns its simulators, so nothing is shared
+// but the trace. Results come back in grid order whatever the schedule.
+std::vector<SweepResult> run_sweep(const SweepGrid &grid, const TraceFile &trace, size_t threads);
+
+void print_sweep_csv(const std::vector<SweepResult> &results);
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own job deque. run() seeds the
+// deques with contiguous index ranges; a worker takes jobs from the back of
+// its own deque and, once that is empty, steals from the front of the
+// others', so uneven jobs (a large heap next to a small one) still keep every
+// core busy. Jobs do not spawn jobs, so a worker that finds every deque empty
+// is done for the batch.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t threads) {
+        if (threads == 0) threads = 1;
+        for (size_t i = 0; i < threads; i++) queues.emplace_back(new Queue);
+        for (size_t i = 0; i < threads; i++) workers.emplace_back(&WorkStealingPool::work, this, i);
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : workers) t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    // Calls fn(i) for every i in [0, jobs) and returns once all have finished.
+    void run(size_t jobs, const std::function<void(size_t)> &fn) {
+        if (jobs == 0) return;
+        size_t n = queues.size();
+        for (size_t w = 0; w < n; w++) {
+            std::lock_guard<std::mutex> g(queues[w]->lock);
+            for (size_t i = jobs * w / n; i < jobs * (w + 1) / n; i++) queues[w]->jobs.push_back(i);
+        }
+        std::unique_lock<std::mutex> g(lock);
+        task = &fn;
+        remaining = jobs;
+        generation++;
+        wake.notify_all();
+        done.wait(g, [this] { return remaining == 0 && active == 0; });
+        task = nullptr;
+    }
+
+    // Jobs taken from another worker's deque since construction.
+    uint64_t steals() const { return stolen.load(); }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake, done;
+    const std::function<void(size_t)> *task = nullptr;
+    size_t remaining = 0;   // jobs of the current batch not yet finished
+    size_t active = 0;      // workers still draining deques for this batch
+    uint64_t generation = 0;
+    bool stopping = false;
+    std::atomic<uint64_t> stolen{0};
+
+    bool take(size_t self, size_t &job) {
+        {
+            Queue &own = *queues[self];
+            std::lock_guard<std::mutex> g(own.lock);
+            if (!own.jobs.empty()) {
+                job = own.jobs.back();
+                own.jobs.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            Queue &victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> g(victim.lock);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                stolen++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(size_t self) {
+        uint64_t seen = 0;
+        while (true) {
+            const std::function<void(size_t)> *fn;
+            {
+                std::unique_lock<std::mutex> g(lock);
+                wake.wait(g, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                fn = task;
+                if (!fn) continue;   // woke after the batch already finished
+                active++;
+            }
+            size_t job;
+            while (take(self, job)) {
+                (*fn)(job);
+                std::lock_guard<std::mutex> g(lock);
+                remaining--;
+            }
+            std::lock_guard<std::mutex> g(lock);
+            if (--active == 0 && remaining == 0) done.notify_all();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "frag_telemetry.h"
+#include <cstring>
+#include <memory>
+#include "../allocator/memory_manager.h"
+
+namespace {
+
+const char FRAG_MAGIC[4] = {'M', 'S', 'F', 'T'};
+
+struct FragHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t bins;
+    uint32_t pad;
+};
+
+void write_csv_header(std::FILE *fp, size_t bins) {
+    for (size_t c = 0; c < FragColumns::COUNT; c++) std::fprintf(fp, "%s%s", c ? "," : "", FragColumns::name(c));
+    std::fprintf(fp, ",utilization,external_frag");
+    for (size_t b = 0; b < bins; b++) std::fprintf(fp, ",free_2^%zu", b);
+    std::fprintf(fp, "\n");
+}
+
+// One CSV row; row-wise text is the only place the columns are recombined.
+void write_csv_row(std::FILE *fp, const uint64_t *v, const uint32_t *hist, size_t bins) {
+    uint64_t total = v[FragColumns::USED] + v[FragColumns::FREE];
+    double util = total ? (double)v[FragColumns::USED] / total * 100.0 : 0.0;
+    double ext = v[FragColumns::FREE]
+                     ? (1.0 - (double)v[FragColumns::LARGEST_FREE] / v[FragColumns::FREE]) * 100.0
+                     : 0.0;
+    for (size_t c = 0; c < FragColumns::COUNT; c++)
+        std::fprintf(fp, "%s%llu", c ? "," : "", (unsigned long long)v[c]);
+    std::fprintf(fp, ",%.2f,%.2f", util, ext);
+    for (size_t b = 0; b < bins; b++) std::fprintf(fp, ",%u", hist[b]);
+    std::fprintf(fp, "\n");
+}
+
+}  // namespace
+
+const char *FragColumns::name(size_t col) {
+    static const char *names[] = {"op", "used", "free", "largest_free", "free_blocks", "internal_frag"};
+    return col < COUNT ? names[col] : "?";
+}
+
+FragTelemetry::Chunk::Chunk() {
+    for (auto &c : cols) c.resize(CHUNK_ROWS);
+    for (auto &h : hist) h.resize(CHUNK_ROWS);
+}
+
+FragTelemetry::~FragTelemetry() {
+    close();
+}
+
+bool FragTelemetry::open(const std::string &path, uint64_t every, std::string &err) {
+    close();
+    if (every == 0) {
+        err = "sampling interval must be at least 1";
+        return false;
+    }
+    csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    fp = std::fopen(path.c_str(), csv ? "w" : "wb");
+    if (!fp) {
+        err = "cannot create " + path;
+        return false;
+    }
+    if (csv) {
+        write_csv_header(fp, FRAG_HIST_BINS);
+    } else {
+        FragHeader h;
+        std::memcpy(h.magic, FRAG_MAGIC, 4);
+        h.version = FRAG_TELEMETRY_VERSION;
+        h.bins = FRAG_HIST_BINS;
+        h.pad = 0;
+        std::fwrite(&h, sizeof(h), 1, fp);
+    }
+    file_path = path;
+    interval = every;
+    ops = 0;
+    sampled = 0;
+    stopping = false;
+    write_error = false;
+    filling = new Chunk;
+    writer = std::thread(&FragTelemetry::writer_loop, this);
+    return true;
+}
+
+void FragTelemetry::sample(const MemoryManagerSimulator &mm) {
+    MemoryStats st = mm.snapshot();
+    Chunk &c = *filling;
+    size_t row = c.rows++;
+    c.cols[FragColumns::OP][row] = ops;
+    c.cols[FragColumns::USED][row] = st.used;
+    c.cols[FragColumns::FREE][row] = st.free;
+    c.cols[FragColumns::LARGEST_FREE][row] = st.largest_free;
+    c.cols[FragColumns::FREE_BLOCKS][row] = st.free_blocks;
+    c.cols[FragColumns::INTERNAL_FRAG][row] = st.internal_frag;
+    uint32_t hist[FRAG_HIST_BINS];
+    mm.free_histogram(hist, FRAG_HIST_BINS);
+    for (size_t b = 0; b < FRAG_HIST_BINS; b++) c.hist[b][row] = hist[b];
+    sampled++;
+    if (c.rows == CHUNK_ROWS) hand_off();
+}
+
+// Queues the filling chunk for the writer and takes a recycled one, so the
+// simulation thread never allocates in steady state.
+void FragTelemetry::hand_off() {
+    Chunk *next = nullptr;
+    {
+        std::lock_guard<std::mutex> g(lock);
+        full.push_back(filling);
+        if (!spare.empty()) {
+            next = spare.back();
+            spare.pop_back();
+        }
+    }
+    wake.notify_one();
+    filling = next ? next : new Chunk;
+}
+
+void FragTelemetry::writer_loop() {
+    std::unique_lock<std::mutex> g(lock);
+    while (true) {
+        wake.wait(g, [&] { return stopping || !full.empty(); });
+        if (full.empty()) break;   // stopping with nothing left
+        Chunk *c = full.front();
+        full.pop_front();
+        g.unlock();
+        bool ok = write_chunk(*c);
+        c->rows = 0;
+        g.lock();
+        if (!ok) write_error = true;
+        spare.push_back(c);
+    }
+}
+
+bool FragTelemetry::write_chunk(const Chunk &c) {
+    if (c.rows == 0) return true;
+    if (csv) {
+        uint64_t v[FragColumns::COUNT];
+        uint32_t h[FRAG_HIST_BINS];
+        for (size_t r = 0; r < c.rows; r++) {
+            for (size_t k = 0; k < FragColumns::COUNT; k++) v[k] = c.cols[k][r];
+            for (size_t b = 0; b < FRAG_HIST_BINS; b++) h[b] = c.hist[b][r];
+            write_csv_row(fp, v, h, FRAG_HIST_BINS);
+        }
+        return !std::ferror(fp);
+    }
+    uint32_t head[2] = {(uint32_t)c.rows, 0};
+    bool ok = std::fwrite(head, sizeof(head), 1, fp) == 1;
+    for (const auto &col : c.cols) ok = ok && std::fwrite(col.data(), sizeof(uint64_t), c.rows, fp) == c.rows;
+    for (const auto &col : c.hist) ok = ok && std::fwrite(col.data(), sizeof(uint32_t), c.rows, fp) == c.rows;
+    return ok;
+}
+
+bool FragTelemetry::close() {
+    if (!fp) return true;
+    {
+        std::lock_guard<std::mutex> g(lock);
+        if (filling->rows) full.push_back(filling);
+        else spare.push_back(filling);
+        filling = nullptr;
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    for (Chunk *c : spare) delete c;
+    spare.clear();
+    bool ok = !write_error;
+    ok = std::fclose(fp) == 0 && ok;
+    fp = nullptr;
+    return ok;
+}
+
+bool frag_telemetry_to_csv(const std::string &in_path, const std::string &out_path, uint64_t &rows,
+                           std::string &err) {
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> in(std::fopen(in_path.c_str(), "rb"), std::fclose);
+    if (!in) {
+        err = "cannot open " + in_path;
+        return false;
+    }
+    FragHeader h;
+    if (std::fread(&h, sizeof(h), 1, in.get()) != 1 || std::memcmp(h.magic, FRAG_MAGIC, 4) != 0) {
+        err = in_path + " is not a telemetry file";
+        return false;
+    }
+    if (h.version != FRAG_TELEMETRY_VERSION || h.bins == 0 || h.bins > 64) {
+        err = "unsupported telemetry version or layout";
+        return false;
+    }
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> out(std::fopen(out_path.c_str(), "w"), std::fclose);
+    if (!out) {
+        err = "cannot create " + out_path;
+        return false;
+    }
+    write_csv_header(out.get(), h.bins);
+
+    rows = 0;
+    uint32_t head[2];
+    std::vector<uint64_t> cols[FragColumns::COUNT];
+    std::vector<std::vector<uint32_t>> hist(h.bins);
+    while (std::fread(head, sizeof(head), 1, in.get()) == 1) {
+        size_t n = head[0];
+        bool ok = true;
+        for (auto &col : cols) {
+            col.resize(n);
+            ok = ok && std::fread(col.data(), sizeof(uint64_t), n, in.get()) == n;
+        }
+        for (auto &col : hist) {
+            col.resize(n);
+            ok = ok && std::fread(col.data(), sizeof(uint32_t), n, in.get()) == n;
+        }
+        if (!ok) {
+            err = "truncated chunk after " + std::to_string(rows) + " rows";
+            return false;
+        }
+        uint64_t v[FragColumns::COUNT];
+        uint32_t hv[64];
+        for (size_t r = 0; r < n; r++) {
+            for (size_t k = 0; k < FragColumns::COUNT; k++) v[k] = cols[k][r];
+            for (size_t b = 0; b < h.bins; b++) hv[b] = hist[b][r];
+            write_csv_row(out.get(), v, hv, h.bins);
+        }
+        rows += n;
+    }
+    return true;
+}
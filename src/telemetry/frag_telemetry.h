@@ -0,0 +1,96 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MemoryManagerSimulator;
+
+// Fragmentation time series: every `interval` malloc/free calls the heap is
+// sampled and the sample appended to a file, so a long trace shows how
+// fragmentation evolves rather than only where it ends.
+//
+// Samples are stored column-major in fixed-size chunks. A full chunk is
+// handed to a writer thread, which owns all file I/O; the simulation thread
+// only fills columns and swaps chunk pointers under a mutex.
+//
+// A path ending in ".csv" gets one text row per sample; anything else gets
+// the binary columnar format below, in host (little-endian) byte order:
+//
+//   header: "MSFT" | uint32 version | uint32 histogram bins | uint32 pad
+//   chunk:  uint32 rows | uint32 pad, then each column as a packed array:
+//           op, used, free, largest_free, free_blocks, internal_frag (uint64),
+//           then one uint32 count column per free-size histogram bin
+//
+// Histogram bin b counts free blocks with floor(log2(size)) == b; the last
+// bin also takes everything larger.
+
+constexpr uint32_t FRAG_TELEMETRY_VERSION = 1;
+constexpr size_t FRAG_HIST_BINS = 32;
+
+struct FragColumns {
+    enum { OP, USED, FREE, LARGEST_FREE, FREE_BLOCKS, INTERNAL_FRAG, COUNT };
+    static const char *name(size_t col);
+};
+
+class FragTelemetry {
+public:
+    FragTelemetry() = default;
+    ~FragTelemetry();
+    FragTelemetry(const FragTelemetry &) = delete;
+    FragTelemetry &operator=(const FragTelemetry &) = delete;
+
+    bool open(const std::string &path, uint64_t interval, std::string &err);
+    // Writes the partial chunk, joins the writer and closes the file.
+    bool close();
+    bool active() const { return fp != nullptr; }
+
+    // Called by the allocator after every malloc/free.
+    void tick(const MemoryManagerSimulator &mm) {
+        if (++ops % interval == 0) sample(mm);
+    }
+
+    uint64_t samples() const { return sampled; }
+    const std::string &path() const { return file_path; }
+
+private:
+    static constexpr size_t CHUNK_ROWS = 4096;
+
+    struct Chunk {
+        size_t rows = 0;
+        std::vector<uint64_t> cols[FragColumns::COUNT];
+        std::vector<uint32_t> hist[FRAG_HIST_BINS];
+        Chunk();
+    };
+
+    std::FILE *fp = nullptr;
+    bool csv = false;
+    std::string file_path;
+    uint64_t interval = 1;
+    uint64_t ops = 0;
+    uint64_t sampled = 0;
+    Chunk *filling = nullptr;
+
+    // Shared with the writer thread.
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Chunk *> full;
+    std::vector<Chunk *> spare;
+    bool stopping = false;
+    bool write_error = false;
+    std::thread writer;
+
+    void sample(const MemoryManagerSimulator &mm);
+    void hand_off();
+    void writer_loop();
+    bool write_chunk(const Chunk &c);
+};
+
+// Rewrites a binary telemetry file as CSV (same columns as a ".csv" run).
+bool frag_telemetry_to_csv(const std::string &in_path, const std::string &out_path, uint64_t &rows,
+                           std::string &err);
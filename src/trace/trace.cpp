@@ -0,0 +1,488 @@
+#include "trace.h"
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct TraceHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+};
+static_assert(sizeof(TraceHeader) == 16, "trace header must stay 16 bytes");
+
+const char TRACE_MAGIC[4] = {'M', 'S', 'T', 'R'};
+
+bool check_header(const TraceHeader &h, size_t bytes, std::string &err) {
+    if (std::memcmp(h.magic, TRACE_MAGIC, 4) != 0) {
+        err = "not a memsim trace";
+        return false;
+    }
+    if (h.version != TRACE_VERSION) {
+        err = "unsupported trace version " + std::to_string(h.version);
+        return false;
+    }
+    if (h.count > (bytes - sizeof(TraceHeader)) / sizeof(TraceRecord)) {
+        err = "trace is truncated";
+        return false;
+    }
+    return true;
+}
+
+TraceRecord make_record(TraceOp op, uint64_t arg, uint8_t flags = 0, uint8_t shift = 0, uint32_t arg2 = 0) {
+    TraceRecord r{};
+    r.op = (uint8_t)op;
+    r.flags = flags;
+    r.shift = shift;
+    r.arg2 = arg2;
+    r.arg = arg;
+    return r;
+}
+
+// Block, buddy and slab ids are positive ints; a wider record arg would wrap
+// onto a live id when cast.
+bool valid_id(uint64_t id) { return id > 0 && id <= INT_MAX; }
+
+}  // namespace
+
+TraceFile::~TraceFile() {
+#ifndef _WIN32
+    if (mapping) munmap(mapping, mapping_len);
+#endif
+}
+
+bool TraceFile::open(const std::string &path, std::string &err) {
+    TraceHeader h;
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceHeader)) {
+        ::close(fd);
+        err = "cannot read " + path;
+        return false;
+    }
+    mapping_len = (size_t)st.st_size;
+    mapping = mmap(nullptr, mapping_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        err = "cannot map " + path;
+        return false;
+    }
+    madvise(mapping, mapping_len, MADV_SEQUENTIAL);
+
+    std::memcpy(&h, mapping, sizeof(h));
+    if (!check_header(h, mapping_len, err)) return false;
+    records = reinterpret_cast<const TraceRecord *>(static_cast<const char *>(mapping) + sizeof(TraceHeader));
+    count = h.count;
+    return true;
+#else
+    std::FILE *fp = std::fopen(path.c_str(), "rb");
+    if (!fp) {
+        err = "cannot open " + path;
+        return false;
+    }
+    std::fseek(fp, 0, SEEK_END);
+    size_t bytes = (size_t)std::ftell(fp);
+    std::fseek(fp, 0, SEEK_SET);
+    if (bytes < sizeof(h) || std::fread(&h, sizeof(h), 1, fp) != 1 || !check_header(h, bytes, err)) {
+        if (err.empty()) err = "cannot read " + path;
+        std::fclose(fp);
+        return false;
+    }
+    buffer.resize(h.count);
+    size_t got = std::fread(buffer.data(), sizeof(TraceRecord), h.count, fp);
+    std::fclose(fp);
+    if (got != h.count) {
+        err = "trace is truncated";
+        return false;
+    }
+    records = buffer.data();
+    count = buffer.size();
+    return true;
+#endif
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const std::string &path) {
+    fp = std::fopen(path.c_str(), "wb");
+    if (!fp) return false;
+    TraceHeader h;
+    std::memcpy(h.magic, TRACE_MAGIC, 4);
+    h.version = TRACE_VERSION;
+    h.count = 0;
+    std::fwrite(&h, sizeof(h), 1, fp);
+    pending.reserve(1 << 16);
+    written = 0;
+    return true;
+}
+
+void TraceWriter::write(const TraceRecord &rec) {
+    pending.push_back(rec);
+    if (pending.size() == pending.capacity()) flush();
+}
+
+void TraceWriter::flush() {
+    if (pending.empty()) return;
+    std::fwrite(pending.data(), sizeof(TraceRecord), pending.size(), fp);
+    written += pending.size();
+    pending.clear();
+}
+
+bool TraceWriter::close() {
+    if (!fp) return true;
+    flush();
+    // Patch the record count now that it is known.
+    bool ok = std::fseek(fp, offsetof(TraceHeader, count), SEEK_SET) == 0 &&
+              std::fwrite(&written, sizeof(written), 1, fp) == 1;
+    ok = std::fclose(fp) == 0 && ok;
+    fp = nullptr;
+    return ok;
+}
+
+bool convert_text_trace(std::istream &in, const std::string &out_path, size_t &records, std::string &err) {
+    TraceWriter out;
+    if (!out.open(out_path)) {
+        err = "cannot create " + out_path;
+        return false;
+    }
+
+    records = 0;
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        std::istringstream ss(line);
+        std::string cmd, sub;
+        if (!(ss >> cmd)) continue;
+
+        uint64_t value = 0;
+        bool ok = true;
+        if (cmd == "init") {
+            ok = (ss >> sub >> value) && sub == "memory";
+            if (ok) out.write(make_record(TraceOp::INIT_MEMORY, value));
+        } else if (cmd == "set") {
+            std::string policy;
+            ok = (bool)(ss >> sub >> policy);
+            if (ok && sub == "compaction") {
+                CompactionMode mode = CompactionMode::OFF;
+                uint64_t threshold = 0, budget = 4096;
+                ok = parse_compaction_mode(policy, mode);
+                ss >> threshold >> budget;
+                if (ok) out.write(make_record(TraceOp::SET_COMPACTION, budget, (uint8_t)mode, 0, (uint32_t)threshold));
+            } else {
+                AllocatorType type = AllocatorType::FIRST_FIT;
+                ok = ok && sub == "allocator" && parse_allocator_type(policy, type);
+                if (ok) out.write(make_record(TraceOp::SET_ALLOCATOR, 0, (uint8_t)type));
+            }
+        } else if (cmd == "compact") {
+            out.write(make_record(TraceOp::COMPACT, 0));
+        } else if (cmd == "malloc" || cmd == "free" || cmd == "access" ||
+                   cmd == "buddy_malloc" || cmd == "buddy_free" ||
+                   cmd == "slab_malloc" || cmd == "slab_free") {
+            ok = (bool)(ss >> value);
+            TraceOp op = cmd == "malloc" ? TraceOp::MALLOC
+                       : cmd == "free" ? TraceOp::FREE
+                       : cmd == "access" ? TraceOp::ACCESS
+                       : cmd == "buddy_malloc" ? TraceOp::BUDDY_MALLOC
+                       : cmd == "buddy_free" ? TraceOp::BUDDY_FREE
+                       : cmd == "slab_malloc" ? TraceOp::SLAB_MALLOC
+                       : TraceOp::SLAB_FREE;
+            uint8_t flags = 0;
+            std::string mode;
+            if (op == TraceOp::ACCESS && (ss >> mode) && (mode == "w" || mode == "write")) flags = ACCESS_WRITE;
+            if (op == TraceOp::FREE || op == TraceOp::BUDDY_FREE || op == TraceOp::SLAB_FREE) ok = ok && valid_id(value);
+            if (ok) out.write(make_record(op, value, flags));
+        } else if (cmd == "buddy_init") {
+            std::string engine;
+            uint64_t min_block = 1;
+            ok = (bool)(ss >> value);
+            ss >> engine >> min_block;
+            uint8_t shift = 0;
+            while ((1ULL << shift) < min_block) shift++;
+            uint8_t flags = (uint8_t)(engine == "bitmap" ? BuddyEngine::BITMAP : BuddyEngine::FREE_LIST);
+            if (ok) out.write(make_record(TraceOp::BUDDY_INIT, value, flags, shift));
+        } else if (cmd == "touch" || cmd == "buddy_touch" || cmd == "slab_touch") {
+            uint64_t id = 0;
+            std::string mode;
+            ok = (bool)(ss >> id >> value) && id <= UINT32_MAX;
+            ss >> mode;
+            TraceOp op = cmd == "touch" ? TraceOp::TOUCH : cmd == "buddy_touch" ? TraceOp::BUDDY_TOUCH : TraceOp::SLAB_TOUCH;
+            uint8_t flags = mode == "w" || mode == "write" ? ACCESS_WRITE : 0;
+            if (ok) out.write(make_record(op, value, flags, 0, (uint32_t)id));
+        } else if (cmd == "vm_init") {
+            TlbConfig tlb;
+            std::string policy;
+            ss >> tlb.entries >> tlb.assoc >> policy;
+            ok = (policy.empty() || parse_policy(policy, tlb.policy)) && tlb.valid();
+            if (ok) out.write(make_record(TraceOp::VM_INIT, tlb.entries, (uint8_t)tlb.policy, 0, (uint32_t)tlb.assoc));
+        } else if (cmd == "vm_create") {
+            value = 4096;
+            ss >> value;
+            out.write(make_record(TraceOp::VM_CREATE, value));
+        } else if (cmd == "vm_access") {
+            uint64_t pid = 0;
+            std::string mode;
+            ok = (bool)(ss >> pid >> value) && pid <= UINT32_MAX;
+            ss >> mode;
+            uint8_t flags = mode == "w" || mode == "write" ? ACCESS_WRITE : 0;
+            if (ok) out.write(make_record(TraceOp::VM_ACCESS, value, flags, 0, (uint32_t)pid));
+        } else if (cmd == "vm_destroy") {
+            uint64_t pid = 0;
+            ok = (bool)(ss >> pid) && pid <= UINT32_MAX;
+            if (ok) out.write(make_record(TraceOp::VM_DESTROY, 0, 0, 0, (uint32_t)pid));
+        } else if (cmd == "vm_paging") {
+            std::string policy;
+            uint64_t window = 1024;
+            PagePolicy p = PagePolicy::LRU;
+            ok = (bool)(ss >> value >> policy) && parse_page_policy(policy, p);
+            ss >> window;
+            if (ok) out.write(make_record(TraceOp::VM_PAGING, value, (uint8_t)p, 0, (uint32_t)window));
+        } else if (cmd == "slab_init") {
+            value = 4096;
+            ss >> value;
+            out.write(make_record(TraceOp::SLAB_INIT, value));
+        } else {
+            continue;
+        }
+
+        if (!ok) {
+            err = "line " + std::to_string(line_no) + ": cannot parse '" + line + "'";
+            return false;
+        }
+        records++;
+    }
+
+    if (!out.close()) {
+        err = "cannot write " + out_path;
+        return false;
+    }
+    return true;
+}
+
+bool resolve_touch(const MemoryManagerSimulator &mm, const BuddyAllocator *ba, const SlabAllocator *slab,
+                   TraceOp op, int id, uint64_t offset, uint64_t &address) {
+    uint64_t start = 0, size = 0;
+    bool ok = false;
+    if (op == TraceOp::TOUCH) {
+        size_t s, z;
+        ok = mm.block_extent(id, s, z);
+        start = s;
+        size = z;
+    } else if (op == TraceOp::BUDDY_TOUCH) {
+        ok = ba && ba->blockExtent(id, start, size);
+    } else if (op == TraceOp::SLAB_TOUCH) {
+        ok = slab && slab->objectExtent(id, start, size);
+    }
+    if (!ok || offset >= size) return false;
+    address = start + offset;
+    return true;
+}
+
+TraceReplayer::TraceReplayer(MemoryManagerSimulator &mm_, BuddyAllocator *&ba_, MultiLevelCache &cache_)
+    : mm(mm_), ba(ba_), cache(cache_) {}
+
+std::vector<uint64_t> vm_next_use_index(const TraceRecord *first, const TraceRecord *last) {
+    std::vector<uint64_t> next(last - first, NEVER_USED_AGAIN);
+    std::vector<uint64_t> keys(last - first, NEVER_USED_AGAIN);
+    std::vector<unsigned> shifts(1, 0);   // pid -> page shift, per VM_INIT epoch
+    uint64_t epoch = 0;
+    for (const TraceRecord *r = first; r != last; ++r) {
+        switch ((TraceOp)r->op) {
+        case TraceOp::VM_INIT:
+            epoch++;
+            shifts.assign(1, 0);
+            break;
+        case TraceOp::VM_CREATE: {
+            unsigned shift = VirtualMemory::pageShift(r->arg);
+            if (shift) shifts.push_back(shift);
+            break;
+        }
+        case TraceOp::VM_ACCESS:
+            if (r->arg2 > 0 && r->arg2 < shifts.size() && (r->arg >> VirtualMemory::VA_BITS) == 0)
+                keys[r - first] = VirtualMemory::pageKey(r->arg2, r->arg >> shifts[r->arg2]) ^ epoch << 58;
+            break;
+        default:
+            break;
+        }
+    }
+    std::unordered_map<uint64_t, uint64_t> seen;
+    for (size_t i = keys.size(); i-- > 0;) {
+        if (keys[i] == NEVER_USED_AGAIN) continue;
+        auto ins = seen.emplace(keys[i], i);
+        if (!ins.second) {
+            next[i] = ins.first->second;
+            ins.first->second = i;
+        }
+    }
+    return next;
+}
+
+ReplaySummary TraceReplayer::run(const TraceRecord *first, const TraceRecord *last) {
+    ReplaySummary s;
+    // OPT needs the future; build the next-use index only when it is asked for.
+    bool opt = vm && *vm && (*vm)->pagePolicy() == PagePolicy::OPT;
+    for (const TraceRecord *r = first; r != last && !opt; ++r)
+        opt = (TraceOp)r->op == TraceOp::VM_PAGING && (PagePolicy)r->flags == PagePolicy::OPT;
+    std::vector<uint64_t> next_use;
+    if (opt) next_use = vm_next_use_index(first, last);
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (const TraceRecord *r = first; r != last; ++r) {
+        if ((ignored >> (r->op & 31)) & 1) continue;
+        switch ((TraceOp)r->op) {
+        case TraceOp::INIT_MEMORY:
+            mm.init(r->arg);
+            break;
+        case TraceOp::SET_ALLOCATOR:
+            if (r->flags > (uint8_t)AllocatorType::TLSF) s.failures++;
+            else mm.setAllocator((AllocatorType)r->flags);
+            break;
+        case TraceOp::SET_COMPACTION:
+            if (r->flags > (uint8_t)CompactionMode::INCREMENTAL) s.failures++;
+            else mm.setCompaction((CompactionMode)r->flags, r->arg2, r->arg);
+            break;
+        case TraceOp::COMPACT:
+            mm.compact();
+            break;
+        case TraceOp::MALLOC:
+            s.mallocs++;
+            if (mm.malloc_block(r->arg) == -1) s.failures++;
+            break;
+        case TraceOp::FREE:
+            s.frees++;
+            if (!valid_id(r->arg) || !mm.free_block((int)r->arg)) s.failures++;
+            break;
+        case TraceOp::ACCESS:
+            s.accesses++;
+            cache.access(r->arg, (r->flags & ACCESS_WRITE) != 0);
+            break;
+        case TraceOp::BUDDY_INIT:
+            // The allocator rounds the size up to a power of two; past the top
+            // bit of size_t there is none, and a wider shift is undefined.
+            if (r->flags > (uint8_t)BuddyEngine::BITMAP || r->shift >= sizeof(size_t) * 8 || r->arg == 0 ||
+                r->arg > (uint64_t)((size_t)1 << (sizeof(size_t) * 8 - 1))) {
+                s.failures++;
+                break;
+            }
+            if (slab) {
+                delete *slab;
+                *slab = nullptr;
+            }
+            if (vm) {
+                delete *vm;
+                *vm = nullptr;
+            }
+            delete ba;
+            ba = new BuddyAllocator(r->arg, (BuddyEngine)r->flags, (size_t)1 << r->shift);
+            break;
+        case TraceOp::BUDDY_MALLOC:
+            s.buddy_mallocs++;
+            if (!ba || !ba->allocate(r->arg).ok()) s.failures++;
+            break;
+        case TraceOp::BUDDY_FREE:
+            s.buddy_frees++;
+            if (!ba || !valid_id(r->arg) || !ba->freeBlock((int)r->arg).ok()) s.failures++;
+            break;
+        case TraceOp::SLAB_INIT:
+            if (!slab || !ba) {
+                s.failures++;
+                break;
+            }
+            delete *slab;
+            *slab = new SlabAllocator(*ba, r->arg);
+            break;
+        case TraceOp::SLAB_MALLOC:
+            s.slab_mallocs++;
+            if (!slab || !*slab || !(*slab)->allocate(r->arg).ok()) s.failures++;
+            break;
+        case TraceOp::SLAB_FREE:
+            s.slab_frees++;
+            if (!slab || !*slab || !valid_id(r->arg) || !(*slab)->freeObject((int)r->arg)) s.failures++;
+            break;
+        case TraceOp::TOUCH:
+        case TraceOp::BUDDY_TOUCH:
+        case TraceOp::SLAB_TOUCH: {
+            s.touches++;
+            uint64_t address;
+            if (resolve_touch(mm, ba, slab ? *slab : nullptr, (TraceOp)r->op, (int)r->arg2, r->arg, address))
+                cache.access(address, (r->flags & ACCESS_WRITE) != 0);
+            else
+                s.failures++;
+            break;
+        }
+        case TraceOp::VM_INIT: {
+            TlbConfig tlb{r->arg, r->arg2, (CachePolicy)r->flags};
+            if (!vm || !ba || !tlb.valid()) {
+                s.failures++;
+                break;
+            }
+            delete *vm;
+            *vm = new VirtualMemory(*ba, tlb);
+            break;
+        }
+        case TraceOp::VM_CREATE:
+            if (!vm || !*vm || (*vm)->createProcess(r->arg) == -1) s.failures++;
+            break;
+        case TraceOp::VM_ACCESS: {
+            s.vm_accesses++;
+            uint64_t paddr;
+            uint64_t use = opt ? next_use[r - first] : NEVER_USED_AGAIN;
+            if (vm && *vm && (*vm)->translate((int)r->arg2, r->arg, (r->flags & ACCESS_WRITE) != 0, paddr, use) ==
+                             VmStatus::OK)
+                cache.access(paddr, (r->flags & ACCESS_WRITE) != 0);
+            else
+                s.failures++;
+            break;
+        }
+        case TraceOp::VM_PAGING:
+            if (!vm || !*vm || r->flags > (uint8_t)PagePolicy::OPT) s.failures++;
+            else (*vm)->configurePaging(r->arg, (PagePolicy)r->flags, r->arg2);
+            break;
+        case TraceOp::VM_DESTROY:
+            if (!vm || !*vm || !(*vm)->destroyProcess((int)r->arg2)) s.failures++;
+            break;
+        default:
+            s.failures++;
+            break;
+        }
+    }
+
+    s.ops = last - first;
+    s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return s;
+}
+
+void print_replay_summary(const ReplaySummary &s) {
+    std::cout << "\n=== REPLAY SUMMARY ===\n";
+    std::cout << "Records: " << s.ops << "\n";
+    std::cout << "malloc: " << s.mallocs << "  free: " << s.frees << "  access: " << s.accesses << "\n";
+    if (s.touches) std::cout << "touch: " << s.touches << "\n";
+    if (s.vm_accesses) std::cout << "vm_access: " << s.vm_accesses << "\n";
+    std::cout << "buddy_malloc: " << s.buddy_mallocs << "  buddy_free: " << s.buddy_frees << "\n";
+    if (s.slab_mallocs || s.slab_frees)
+        std::cout << "slab_malloc: " << s.slab_mallocs << "  slab_free: " << s.slab_frees << "\n";
+    std::cout << "Failed operations: " << s.failures << "\n";
+    std::cout << "Elapsed: " << s.seconds << " s";
+    if (s.seconds > 0) std::cout << " (" << (uint64_t)(s.ops / s.seconds) << " ops/s)";
+    std::cout << "\n";
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <istream>
+#include <string>
+#include <vector>
+#include "../allocator/memory_manager.h"
+#include "../buddy/buddy_allocator.h"
+#include "../cache/multilevel_cache.h"
+#include "../slab/slab_allocator.h"
+#include "../vm/virtual_memory.h"
+
+// Binary trace format: a 16-byte header followed by fixed-width 16-byte
+// records in host (little-endian) byte order.
+//
+//   header: "MSTR" | uint32 version | uint64 record count
+//   record: uint8 op | uint8 flags | uint8 shift | uint8 pad | uint32 arg2 | uint64 arg
+enum class TraceOp : uint8_t {
+    INIT_MEMORY = 1,   // arg = size
+    SET_ALLOCATOR,     // flags = AllocatorType
+    MALLOC,            // arg = size
+    FREE,              // arg = block id
+    ACCESS,            // arg = address, flags = ACCESS_WRITE for a store
+    BUDDY_INIT,        // arg = size, flags = BuddyEngine, shift = log2(min_block)
+    BUDDY_MALLOC,      // arg = size
+    BUDDY_FREE,        // arg = block id
+    SLAB_INIT,         // arg = slab size
+    SLAB_MALLOC,       // arg = size
+    SLAB_FREE,         // arg = object id
+    TOUCH,             // arg = offset, arg2 = block id, flags = ACCESS_WRITE for a store
+    BUDDY_TOUCH,       // arg = offset, arg2 = buddy block id, flags as TOUCH
+    SLAB_TOUCH,        // arg = offset, arg2 = slab object id, flags as TOUCH
+    VM_INIT,           // arg = TLB entries, arg2 = TLB associativity, flags = CachePolicy
+    VM_CREATE,         // arg = page size
+    VM_ACCESS,         // arg = virtual address, arg2 = pid, flags = ACCESS_WRITE for a store
+    VM_DESTROY,        // arg2 = pid
+    VM_PAGING,         // arg = max frames (0 = buddy heap), arg2 = working-set window, flags = PagePolicy
+    SET_COMPACTION,    // flags = CompactionMode, arg = byte budget, arg2 = fragmentation threshold (%)
+    COMPACT
+};
+
+struct TraceRecord {
+    uint8_t op;
+    uint8_t flags;
+    uint8_t shift;
+    uint8_t pad;
+    uint32_t arg2;
+    uint64_t arg;
+};
+static_assert(sizeof(TraceRecord) == 16, "trace records must stay 16 bytes");
+
+constexpr uint8_t ACCESS_WRITE = 1;
+
+constexpr uint32_t TRACE_VERSION = 1;
+
+// Read-only view of a trace file: mmapped where available, otherwise read
+// into memory with one bulk read.
+class TraceFile {
+public:
+    TraceFile() = default;
+    ~TraceFile();
+    TraceFile(const TraceFile &) = delete;
+    TraceFile &operator=(const TraceFile &) = delete;
+
+    bool open(const std::string &path, std::string &err);
+    const TraceRecord *begin() const { return records; }
+    const TraceRecord *end() const { return records + count; }
+    size_t size() const { return count; }
+
+private:
+    const TraceRecord *records = nullptr;
+    size_t count = 0;
+    void *mapping = nullptr;
+    size_t mapping_len = 0;
+    std::vector<TraceRecord> buffer;
+};
+
+// Appends records through a large buffer and patches the header count on close.
+class TraceWriter {
+public:
+    ~TraceWriter();
+    bool open(const std::string &path);
+    void write(const TraceRecord &rec);
+    bool close();
+
+private:
+    std::FILE *fp = nullptr;
+    std::vector<TraceRecord> pending;
+    uint64_t written = 0;
+    void flush();
+};
+
+// Translates the text command language (the files in tests/) into records.
+// Commands that only print (dump, stats, visualize, ...) are dropped.
+bool convert_text_trace(std::istream &in, const std::string &out_path, size_t &records, std::string &err);
+
+// Turns (allocation id, offset) into the address the allocator placed it
+// at. Fails for unknown or freed ids and offsets past the block.
+bool resolve_touch(const MemoryManagerSimulator &mm, const BuddyAllocator *ba, const SlabAllocator *slab,
+                   TraceOp op, int id, uint64_t offset, uint64_t &address);
+
+struct ReplaySummary {
+    uint64_t ops = 0;
+    uint64_t mallocs = 0, frees = 0, accesses = 0;
+    uint64_t buddy_mallocs = 0, buddy_frees = 0;
+    uint64_t slab_mallocs = 0, slab_frees = 0;
+    uint64_t touches = 0;   // id + offset accesses resolved into the cache
+    uint64_t vm_accesses = 0;
+    uint64_t failures = 0;
+    double seconds = 0.0;
+};
+
+// Dispatches records straight into the simulators without any per-op output.
+class TraceReplayer {
+public:
+    TraceReplayer(MemoryManagerSimulator &mm, BuddyAllocator *&ba, MultiLevelCache &cache);
+    ReplaySummary run(const TraceRecord *first, const TraceRecord *last);
+
+    // Skips every record of this op, e.g. so a sweep can pin the heap size
+    // or allocator that the trace would otherwise set.
+    void ignore(TraceOp op) { ignored |= 1u << (unsigned)op; }
+
+    // Slab records need somewhere to live; without this they count as failures.
+    // The slab layer is dropped whenever a BUDDY_INIT replaces its buddy heap.
+    void attachSlab(SlabAllocator *&s) { slab = &s; }
+    // Same for VM records; the virtual memory layer also lives on the buddy heap.
+    void attachVm(VirtualMemory *&v) { vm = &v; }
+
+private:
+    MemoryManagerSimulator &mm;
+    BuddyAllocator *&ba;
+    MultiLevelCache &cache;
+    SlabAllocator **slab = nullptr;
+    VirtualMemory **vm = nullptr;
+    uint32_t ignored = 0;
+};
+
+// For every VM_ACCESS record, the index of the next VM_ACCESS record that
+// touches the same page (NEVER_USED_AGAIN if none), following the pids and
+// page sizes the trace's own VM_INIT/VM_CREATE records set up. One forward
+// and one backward pass; this is what lets OPT evict in O(log frames).
+std::vector<uint64_t> vm_next_use_index(const TraceRecord *first, const TraceRecord *last);
+
+void print_replay_summary(const ReplaySummary &s);
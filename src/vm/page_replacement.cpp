@@ -0,0 +1,227 @@
+#include "page_replacement.h"
+#include <algorithm>
+
+const char *page_policy_name(PagePolicy p) {
+    switch (p) {
+    case PagePolicy::FIFO: return "FIFO";
+    case PagePolicy::LRU: return "LRU";
+    case PagePolicy::CLOCK: return "CLOCK";
+    case PagePolicy::ARC: return "ARC";
+    case PagePolicy::OPT: return "OPT";
+    }
+    return "?";
+}
+
+bool parse_page_policy(const std::string &name, PagePolicy &out) {
+    if (name == "fifo") out = PagePolicy::FIFO;
+    else if (name == "lru") out = PagePolicy::LRU;
+    else if (name == "clock") out = PagePolicy::CLOCK;
+    else if (name == "arc") out = PagePolicy::ARC;
+    else if (name == "opt") out = PagePolicy::OPT;
+    else return false;
+    return true;
+}
+
+PageReplacer::PageReplacer(PagePolicy policy, size_t capacity) : pol(policy), capacity(capacity) {}
+
+void PageReplacer::grow(uint32_t frame) {
+    if (frame < where.size()) return;
+    size_t n = std::max<size_t>(frame + 1, where.size() * 2);
+    prev.resize(n, NIL);
+    next.resize(n, NIL);
+    where.resize(n, NONE);
+    referenced.resize(n, 0);
+    keys.resize(n, 0);
+    heap_pos.resize(n, NIL);
+    next_use.resize(n, NEVER_USED_AGAIN);
+}
+
+void PageReplacer::append(uint8_t w, uint32_t frame) {
+    FrameList &l = list(w);
+    prev[frame] = l.tail;
+    next[frame] = NIL;
+    if (l.tail != NIL) next[l.tail] = frame; else l.head = frame;
+    l.tail = frame;
+    l.size++;
+    where[frame] = w;
+}
+
+void PageReplacer::unlink(uint32_t frame) {
+    FrameList &l = list(where[frame]);
+    if (prev[frame] != NIL) next[prev[frame]] = next[frame]; else l.head = next[frame];
+    if (next[frame] != NIL) prev[next[frame]] = prev[frame]; else l.tail = prev[frame];
+    l.size--;
+    where[frame] = NONE;
+}
+
+size_t PageReplacer::arcCapacity() const { return capacity ? capacity : std::max<size_t>(live, 1); }
+
+void PageReplacer::forgetOldest(std::list<uint64_t> &ghost) {
+    ghosts.erase(ghost.back());
+    ghost.pop_back();
+}
+
+void PageReplacer::fault(uint64_t key) {
+    pending = NONE;
+    drop_t1 = false;
+    if (pol != PagePolicy::ARC) return;
+    size_t c = arcCapacity();
+    auto it = ghosts.find(key);
+    if (it == ghosts.end()) {
+        // A new page: keep T1 + B1 within c and everything within 2c.
+        size_t l1 = t1.size + b1.size();
+        if (l1 >= c) {
+            if (t1.size < c && !b1.empty()) forgetOldest(b1);
+            else drop_t1 = true;
+        } else if (!b2.empty() && l1 + t2.size + b2.size() >= 2 * c) {
+            forgetOldest(b2);
+        }
+        return;
+    }
+
+    // A ghost hit means the list it fell out of was too small: grow its share.
+    if (!it->second.first) {
+        size_t delta = std::max<size_t>(1, b1.empty() ? 1 : b2.size() / b1.size());
+        arc_p = std::min(c, arc_p + delta);
+        b1.erase(it->second.second);
+        pending = IN_T1;
+    } else {
+        size_t delta = std::max<size_t>(1, b2.empty() ? 1 : b1.size() / b2.size());
+        arc_p = arc_p > delta ? arc_p - delta : 0;
+        b2.erase(it->second.second);
+        pending = IN_T2;
+    }
+    ghosts.erase(it);
+}
+
+void PageReplacer::insert(uint32_t frame, uint64_t key, uint64_t use) {
+    grow(frame);
+    live++;
+    switch (pol) {
+    case PagePolicy::FIFO:
+    case PagePolicy::LRU:
+        append(IN_T1, frame);
+        break;
+    case PagePolicy::CLOCK:
+        append(IN_T1, frame);
+        referenced[frame] = 1;
+        break;
+    case PagePolicy::ARC: {
+        keys[frame] = key;
+        append(pending == NONE ? IN_T1 : IN_T2, frame);
+        pending = NONE;
+        drop_t1 = false;
+        break;
+    }
+    case PagePolicy::OPT:
+        next_use[frame] = use;
+        heap_pos[frame] = (uint32_t)heap.size();
+        heap.push_back(frame);
+        heapUp(heap.size() - 1);
+        break;
+    }
+}
+
+void PageReplacer::hit(uint32_t frame, uint64_t use) {
+    switch (pol) {
+    case PagePolicy::FIFO:
+        break;
+    case PagePolicy::LRU:
+        unlink(frame);
+        append(IN_T1, frame);
+        break;
+    case PagePolicy::CLOCK:
+        referenced[frame] = 1;
+        break;
+    case PagePolicy::ARC:
+        unlink(frame);
+        append(IN_T2, frame);
+        break;
+    case PagePolicy::OPT: {
+        uint64_t old = next_use[frame];
+        next_use[frame] = use;
+        if (use > old) heapUp(heap_pos[frame]); else heapDown(heap_pos[frame]);
+        break;
+    }
+    }
+}
+
+uint32_t PageReplacer::victim() {
+    uint32_t frame = NIL;
+    switch (pol) {
+    case PagePolicy::FIFO:
+    case PagePolicy::LRU:
+        frame = t1.head;
+        break;
+    case PagePolicy::CLOCK:
+        // the hand is the list head; referenced pages go round once more
+        while (referenced[t1.head]) {
+            uint32_t f = t1.head;
+            referenced[f] = 0;
+            unlink(f);
+            append(IN_T1, f);
+        }
+        frame = t1.head;
+        break;
+    case PagePolicy::ARC: {
+        if (drop_t1 && t1.size > 0) {
+            frame = t1.head;
+            drop_t1 = false;
+            break;
+        }
+        bool from_t1 = t1.size > 0 && ((pending == IN_T2 && t1.size == arc_p) || t1.size > arc_p || t2.size == 0);
+        frame = from_t1 ? t1.head : t2.head;
+        std::list<uint64_t> &ghost = from_t1 ? b1 : b2;
+        ghost.push_front(keys[frame]);
+        ghosts[keys[frame]] = {!from_t1, ghost.begin()};
+        break;
+    }
+    case PagePolicy::OPT:
+        frame = heap.front();
+        break;
+    }
+    remove(frame);
+    return frame;
+}
+
+void PageReplacer::remove(uint32_t frame) {
+    live--;
+    if (pol != PagePolicy::OPT) {
+        unlink(frame);
+        return;
+    }
+    size_t i = heap_pos[frame];
+    heapSwap(i, heap.size() - 1);
+    heap.pop_back();
+    heap_pos[frame] = NIL;
+    if (i < heap.size()) {
+        heapUp(i);
+        heapDown(i);
+    }
+}
+
+void PageReplacer::heapSwap(size_t a, size_t b) {
+    std::swap(heap[a], heap[b]);
+    heap_pos[heap[a]] = (uint32_t)a;
+    heap_pos[heap[b]] = (uint32_t)b;
+}
+
+void PageReplacer::heapUp(size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (next_use[heap[parent]] >= next_use[heap[i]]) break;
+        heapSwap(i, parent);
+        i = parent;
+    }
+}
+
+void PageReplacer::heapDown(size_t i) {
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, top = i;
+        if (l < heap.size() && next_use[heap[l]] > next_use[heap[top]]) top = l;
+        if (r < heap.size() && next_use[heap[r]] > next_use[heap[top]]) top = r;
+        if (top == i) return;
+        heapSwap(i, top);
+        i = top;
+    }
+}
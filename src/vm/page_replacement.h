@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class PagePolicy {
+    FIFO,
+    LRU,
+    CLOCK,   // second chance over the load order
+    ARC,     // adaptive replacement cache (Megiddo & Modha)
+    OPT      // Belady; needs the next-use position of every reference
+};
+
+const char *page_policy_name(PagePolicy p);
+bool parse_page_policy(const std::string &name, PagePolicy &out);
+
+constexpr uint64_t NEVER_USED_AGAIN = UINT64_MAX;
+
+// Picks the resident page to evict. Pages are named by the frame slot
+// they occupy; `key` identifies the page itself (pid, page number) so
+// that ARC can remember recently evicted pages, and `next_use` is the
+// trace position of the page's next reference, read only by OPT.
+//
+// On a fault the caller reports fault(key), calls victim() as often as it
+// needs frames, then insert()s the new page. Every other reference to a
+// resident page is a hit(). remove() drops a page without an eviction.
+//
+// FIFO, LRU and CLOCK keep one intrusive list over frames; ARC keeps two
+// (T1 recency, T2 frequency) plus ghost lists of keys; OPT keeps an indexed
+// max-heap on next use. Every operation is O(1) or O(log frames).
+class PageReplacer {
+public:
+    // capacity sizes ARC's lists; 0 means "the frames currently resident".
+    explicit PageReplacer(PagePolicy policy, size_t capacity = 0);
+
+    PagePolicy policy() const { return pol; }
+
+    void fault(uint64_t key);
+    void insert(uint32_t frame, uint64_t key, uint64_t next_use);
+    void hit(uint32_t frame, uint64_t next_use);
+    uint32_t victim();
+    void remove(uint32_t frame);
+
+    size_t resident() const { return live; }
+    // ARC's current target size for T1, for reporting.
+    size_t arcTarget() const { return arc_p; }
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+    enum : uint8_t { NONE, IN_T1, IN_T2 };
+
+    struct FrameList {
+        uint32_t head = NIL;   // oldest / least recent
+        uint32_t tail = NIL;   // newest / most recent
+        size_t size = 0;
+    };
+
+    PagePolicy pol;
+    size_t capacity;
+    size_t live = 0;
+
+    std::vector<uint32_t> prev, next;
+    std::vector<uint8_t> where;
+    std::vector<uint8_t> referenced;   // CLOCK
+    std::vector<uint64_t> keys;        // ARC
+    FrameList t1, t2;
+
+    // ARC ghosts: most recent at the front
+    std::list<uint64_t> b1, b2;
+    std::unordered_map<uint64_t, std::pair<bool, std::list<uint64_t>::iterator>> ghosts;   // key -> (in b2, node)
+    size_t arc_p = 0;
+    uint8_t pending = NONE;   // ghost list the faulting key was found in
+    bool drop_t1 = false;     // next victim leaves T1 without a ghost
+
+    // OPT
+    std::vector<uint32_t> heap;
+    std::vector<uint32_t> heap_pos;
+    std::vector<uint64_t> next_use;
+
+    void grow(uint32_t frame);
+    FrameList &list(uint8_t w) { return w == IN_T2 ? t2 : t1; }
+    void append(uint8_t w, uint32_t frame);
+    void unlink(uint32_t frame);
+
+    size_t arcCapacity() const;
+    void forgetOldest(std::list<uint64_t> &ghost);
+
+    void heapUp(size_t i);
+    void heapDown(size_t i);
+    void heapSwap(size_t a, size_t b);
+};
@@ -0,0 +1,255 @@
+#include "virtual_memory.h"
+#include "../profile/profile.h"
+#include <algorithm>
+#include <iostream>
+
+VirtualMemory::VirtualMemory(BuddyAllocator &buddy, const TlbConfig &tlb_cfg)
+    : buddy(buddy), tlb_config(tlb_cfg), tlb(tlb_cfg.entries, 1, tlb_cfg.assoc, tlb_cfg.policy),
+      replacer(PagePolicy::LRU) {
+    spaces.emplace_back();
+}
+
+VirtualMemory::~VirtualMemory() {
+    for (const Frame &f : frames)
+        if (f.buddy_id != -1) buddy.freeBlock(f.buddy_id);
+}
+
+unsigned VirtualMemory::pageShift(uint64_t page_size) {
+    if (page_size < 4096 || page_size > ((uint64_t)1 << 30) || (page_size & (page_size - 1)) != 0) return 0;
+    return __builtin_ctzll(page_size);
+}
+
+void VirtualMemory::configurePaging(size_t frames_max, PagePolicy policy, uint64_t window) {
+    max_frames = frames_max;
+    replacer = PageReplacer(policy, frames_max);
+    for (uint32_t i = 0; i < frames.size(); i++)
+        if (frames[i].buddy_id != -1) replacer.insert(i, pageKey(frames[i].pid, frames[i].vpn), NEVER_USED_AGAIN);
+    working_set = WorkingSet(window);
+    window_refs = 0;
+    window_faults = 0;
+    peak_working_set = 0;
+    timeline.clear();
+}
+
+int VirtualMemory::createProcess(uint64_t page_size) {
+    AddressSpace as;
+    as.page_shift = pageShift(page_size);
+    if (as.page_shift == 0) return -1;
+    as.live = true;
+    as.levels = (VA_BITS - as.page_shift + LEVEL_BITS - 1) / LEVEL_BITS;
+    as.root = newTable();
+    spaces.push_back(as);
+    return (int)spaces.size() - 1;
+}
+
+bool VirtualMemory::destroyProcess(int pid) {
+    if (pid <= 0 || (size_t)pid >= spaces.size() || !spaces[pid].live) return false;
+    AddressSpace &as = spaces[pid];
+    for (uint32_t i = 0; i < frames.size(); i++) {
+        Frame &f = frames[i];
+        if (f.buddy_id == -1 || f.pid != pid) continue;
+        bool was_dirty;
+        tlb.invalidate(pageKey(pid, f.vpn), was_dirty);
+        buddy.freeBlock(f.buddy_id);
+        f.buddy_id = -1;
+        free_frames.push_back(i);
+        replacer.remove(i);
+        resident_frames--;
+    }
+    releaseTables(as.root, as.levels - 1);
+    as.live = false;
+    as.root = NIL;
+    as.resident = 0;
+    return true;
+}
+
+uint32_t VirtualMemory::newTable() {
+    uint32_t t;
+    if (!free_tables.empty()) {
+        t = free_tables.back();
+        free_tables.pop_back();
+        std::fill(tables.begin() + (size_t)t * TABLE_ENTRIES, tables.begin() + (size_t)(t + 1) * TABLE_ENTRIES, 0);
+    } else {
+        t = (uint32_t)(tables.size() / TABLE_ENTRIES);
+        tables.resize(tables.size() + TABLE_ENTRIES, 0);
+    }
+    count.tables++;
+    return t;
+}
+
+void VirtualMemory::releaseTables(uint32_t table, unsigned levels_below) {
+    if (levels_below > 0)
+        for (size_t i = 0; i < TABLE_ENTRIES; i++) {
+            uint64_t e = tables[(size_t)table * TABLE_ENTRIES + i];
+            if (e & PTE_PRESENT) releaseTables((uint32_t)(e >> PTE_SHIFT), levels_below - 1);
+        }
+    free_tables.push_back(table);
+    count.tables--;
+}
+
+// Leaf entry for vpn, creating the intermediate tables on the way down.
+uint64_t &VirtualMemory::leaf(AddressSpace &as, uint64_t vpn) {
+    uint32_t table = as.root;
+    for (unsigned l = as.levels - 1; l > 0; l--) {
+        size_t slot = (size_t)table * TABLE_ENTRIES + ((vpn >> (l * LEVEL_BITS)) & (TABLE_ENTRIES - 1));
+        if (!(tables[slot] & PTE_PRESENT)) {
+            uint32_t next = newTable();   // may move `tables`
+            tables[slot] = (uint64_t)next << PTE_SHIFT | PTE_PRESENT;
+        }
+        table = (uint32_t)(tables[slot] >> PTE_SHIFT);
+    }
+    return tables[(size_t)table * TABLE_ENTRIES + (vpn & (TABLE_ENTRIES - 1))];
+}
+
+// A page-sized buddy block, evicting pages while the pool is full or the
+// buddy heap has no block of that size.
+bool VirtualMemory::allocateFrame(uint64_t page_size, BuddyResult &res) {
+    for (;;) {
+        if (max_frames == 0 || resident_frames < max_frames) {
+            res = buddy.allocate(page_size);
+            if (res.ok()) return true;
+        }
+        if (resident_frames == 0) return false;
+        evict(replacer.victim());
+    }
+}
+
+void VirtualMemory::evict(uint32_t f) {
+    Frame &frame = frames[f];
+    AddressSpace &as = spaces[frame.pid];
+    uint64_t &pte = leaf(as, frame.vpn);
+    if (pte & PTE_DIRTY) count.page_outs++;
+    pte = 0;
+    bool was_dirty;
+    tlb.invalidate(pageKey(frame.pid, frame.vpn), was_dirty);
+    buddy.freeBlock(frame.buddy_id);
+    frame.buddy_id = -1;
+    free_frames.push_back(f);
+    as.resident--;
+    resident_frames--;
+    count.evictions++;
+}
+
+VmStatus VirtualMemory::translate(int pid, uint64_t vaddr, bool write, uint64_t &paddr, uint64_t next_use) {
+    MEMSIM_PROFILE_SCOPE(ProfOp::VM_TRANSLATE);
+    if (pid <= 0 || (size_t)pid >= spaces.size() || !spaces[pid].live || (vaddr >> VA_BITS) != 0)
+        return VmStatus::INVALID;
+    AddressSpace &as = spaces[pid];
+    uint64_t vpn = vaddr >> as.page_shift;
+    uint64_t key = pageKey(pid, vpn);
+    count.accesses++;
+    as.accesses++;
+    working_set.reference(key);
+    peak_working_set = std::max(peak_working_set, working_set.size());
+
+    // The TLB only ever holds mapped pages, so a hit needs no fault check;
+    // the leaf is still read to recover the frame, but is not counted as a walk.
+    if (tlb.access(key)) {
+        count.tlb_hits++;
+    } else {
+        count.tlb_misses++;
+        count.walks++;
+        count.walk_reads += as.levels;
+        as.tlb_misses++;
+    }
+
+    VmStatus status = VmStatus::OK;
+    uint64_t *pte = &leaf(as, vpn);
+    if (*pte & PTE_PRESENT) {
+        replacer.hit((uint32_t)(*pte >> PTE_SHIFT), next_use);
+    } else {
+        count.faults++;
+        as.faults++;
+        window_faults++;
+        replacer.fault(key);
+        BuddyResult res;
+        // Evicted pages are resident, so their walks never add tables and `pte` stays valid.
+        if (allocateFrame((uint64_t)1 << as.page_shift, res)) {
+            uint32_t f;
+            if (!free_frames.empty()) {
+                f = free_frames.back();
+                free_frames.pop_back();
+            } else {
+                f = (uint32_t)frames.size();
+                frames.emplace_back();
+            }
+            frames[f] = {res.address, res.id, pid, vpn};
+            *pte = (uint64_t)f << PTE_SHIFT | PTE_PRESENT;
+            as.resident++;
+            resident_frames++;
+            replacer.insert(f, key, next_use);
+        } else {
+            count.fault_failures++;
+            bool was_dirty;
+            tlb.invalidate(key, was_dirty);
+            status = VmStatus::NO_FRAME;
+        }
+    }
+    if (status == VmStatus::OK) {
+        *pte |= PTE_ACCESSED | (write ? PTE_DIRTY : 0);
+        paddr = frames[*pte >> PTE_SHIFT].address + (vaddr & (((uint64_t)1 << as.page_shift) - 1));
+    }
+
+    if (++window_refs == working_set.windowSize()) {
+        size_t pool = max_frames ? max_frames : resident_frames;
+        bool thrashing = working_set.size() > pool && window_faults > THRASH_FAULT_RATE * working_set.windowSize();
+        timeline.push_back({count.accesses, working_set.size(), window_faults, thrashing});
+        window_refs = 0;
+        window_faults = 0;
+    }
+    return status;
+}
+
+void VirtualMemory::stats() const {
+    uint64_t resident_bytes = 0;
+    for (const AddressSpace &as : spaces)
+        if (as.live) resident_bytes += as.resident << as.page_shift;
+
+    std::cout << "\n=== VIRTUAL MEMORY STATS ===\n";
+    std::cout << "TLB: " << tlb_config.entries << " entries, " << tlb_config.assoc << "-way "
+              << policy_name(tlb.policy()) << "\n";
+    std::cout << "Translations: " << count.accesses << "\n";
+    std::cout << "TLB hits: " << count.tlb_hits << "  TLB misses: " << count.tlb_misses << "\n";
+    std::cout << "TLB hit ratio: " << count.tlb_hit_ratio() << "%\n";
+    std::cout << "Page walks: " << count.walks << "  (table entries read: " << count.walk_reads << ")\n";
+    std::cout << "Page faults: " << count.faults << "  (unserved: " << count.fault_failures << ")\n";
+    std::cout << "Frame pool: ";
+    if (max_frames) std::cout << max_frames << " frames"; else std::cout << "buddy heap";
+    std::cout << ", " << page_policy_name(replacer.policy()) << " replacement\n";
+    std::cout << "Evictions: " << count.evictions << "  (dirty page-outs: " << count.page_outs << ")\n";
+    size_t thrashing = 0;
+    for (const WorkingSetSample &w : timeline) thrashing += w.thrashing;
+    std::cout << "Working set (window " << working_set.windowSize() << "): current " << working_set.size()
+              << ", peak " << peak_working_set << "\n";
+    std::cout << "Thrashing windows: " << thrashing << " of " << timeline.size() << "\n";
+    std::cout << "Resident memory: " << resident_bytes << " bytes\n";
+    std::cout << "Page tables: " << count.tables << "  (" << count.tables * TABLE_ENTRIES * sizeof(uint64_t)
+              << " bytes)\n";
+    for (size_t pid = 1; pid < spaces.size(); pid++) {
+        const AddressSpace &as = spaces[pid];
+        if (!as.live) continue;
+        uint64_t page_size = (uint64_t)1 << as.page_shift;
+        std::cout << "pid " << pid << ": " << page_size << "-byte pages, " << as.levels << "-level walk, "
+                  << as.accesses << " accesses, " << as.tlb_misses << " TLB misses, " << as.faults
+                  << " faults, " << as.resident << " resident pages, TLB reach " << tlb_config.entries * page_size
+                  << " bytes\n";
+    }
+
+    if (timeline.empty()) return;
+    // at most 32 rows; longer timelines are merged into equal groups of windows
+    size_t group = (timeline.size() + 31) / 32;
+    std::cout << "Working set timeline (translations: working set, faults):\n";
+    for (size_t i = 0; i < timeline.size(); i += group) {
+        size_t ws = 0;
+        uint64_t faults = 0;
+        bool thrash = false;
+        size_t end = std::min(timeline.size(), i + group);
+        for (size_t j = i; j < end; j++) {
+            ws = std::max(ws, timeline[j].working_set);
+            faults += timeline[j].faults;
+            thrash = thrash || timeline[j].thrashing;
+        }
+        std::cout << "  " << timeline[end - 1].end << ": " << ws << ", " << faults << (thrash ? "  THRASHING" : "")
+                  << "\n";
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../buddy/buddy_allocator.h"
+#include "../cache/cache.h"
+#include "page_replacement.h"
+#include "working_set.h"
+
+struct TlbConfig {
+    size_t entries = 64;
+    size_t assoc = 4;
+    CachePolicy policy = CachePolicy::LRU;
+
+    // 1..MAX_ENTRIES entries of 1..Cache::MAX_WAYS ways; anything larger is
+    // bad input, and would otherwise be allocated as tag arrays up front.
+    static constexpr size_t MAX_ENTRIES = (size_t)1 << 20;
+    bool valid() const {
+        return entries >= 1 && entries <= MAX_ENTRIES && assoc >= 1 && assoc <= Cache::MAX_WAYS &&
+               policy <= CachePolicy::SRRIP;
+    }
+};
+
+struct VmCounters {
+    uint64_t accesses = 0;
+    uint64_t tlb_hits = 0;
+    uint64_t tlb_misses = 0;
+    uint64_t walks = 0;
+    uint64_t walk_reads = 0;       // page-table entries read by walks
+    uint64_t faults = 0;
+    uint64_t fault_failures = 0;   // no frame, even after evicting everything
+    uint64_t evictions = 0;
+    uint64_t page_outs = 0;        // evicted pages that were dirty
+    uint64_t tables = 0;           // live page-table nodes
+
+    double tlb_hit_ratio() const { return accesses ? (double)tlb_hits / accesses * 100.0 : 0.0; }
+};
+
+enum class VmStatus {
+    OK,
+    INVALID,    // unknown pid or address outside the 48-bit space
+    NO_FRAME    // page fault that the buddy heap could not serve
+};
+
+// One window of the working-set timeline.
+struct WorkingSetSample {
+    uint64_t end;          // translations so far
+    size_t working_set;    // distinct pages in the window ending here
+    uint64_t faults;       // faults within the window
+    bool thrashing;
+};
+
+// Per-process radix page tables over a 48-bit virtual address space, with
+// x86-64 style 512-entry tables: 4 KiB pages take a 4-level walk, 2 MiB huge
+// pages 3 levels, 1 GiB pages 2. Every process picks one page size.
+//
+// The TLB is a Cache with one-byte blocks keyed by (pid, virtual page
+// number), so it shares the geometry and replacement policies of the data
+// caches. A TLB miss walks the tables; a missing leaf is a page fault, served
+// with a page-sized block from the BuddyAllocator. Frames go back to the
+// buddy heap when their process is destroyed.
+//
+// Demand paging: the frame pool is bounded by `max_frames` (0 = whatever
+// the buddy heap holds). A fault with no frame to spare evicts a page
+// chosen by a PageReplacer, globally across processes, until the buddy
+// heap can supply a frame of the faulting page's size. A window counts as
+// thrashing when its working set exceeds the pool and more than a quarter
+// of its translations fault.
+class VirtualMemory {
+public:
+    static constexpr unsigned VA_BITS = 48;
+    static constexpr unsigned LEVEL_BITS = 9;
+
+    explicit VirtualMemory(BuddyAllocator &buddy, const TlbConfig &tlb = TlbConfig());
+    ~VirtualMemory();
+    VirtualMemory(const VirtualMemory &) = delete;
+    VirtualMemory &operator=(const VirtualMemory &) = delete;
+
+    // New address space; -1 unless page_size is a power of two in [4 KiB, 1 GiB].
+    int createProcess(uint64_t page_size);
+    bool destroyProcess(int pid);
+
+    // log2 of a supported page size, else 0.
+    static unsigned pageShift(uint64_t page_size);
+    static uint64_t pageKey(int pid, uint64_t vpn) { return (uint64_t)pid << (VA_BITS - 12) | vpn; }
+
+    // Replaces the replacement policy and pool bound; resident pages stay.
+    void configurePaging(size_t max_frames, PagePolicy policy, uint64_t window);
+
+    // next_use is the position of this page's next reference (OPT only).
+    VmStatus translate(int pid, uint64_t vaddr, bool write, uint64_t &paddr,
+                       uint64_t next_use = NEVER_USED_AGAIN);
+
+    const VmCounters &counters() const { return count; }
+    const TlbConfig &tlbConfig() const { return tlb_config; }
+    PagePolicy pagePolicy() const { return replacer.policy(); }
+    const std::vector<WorkingSetSample> &workingSetTimeline() const { return timeline; }
+    void stats() const;
+
+private:
+    static constexpr uint64_t PTE_PRESENT = 1;
+    static constexpr uint64_t PTE_ACCESSED = 2;   // leaf only
+    static constexpr uint64_t PTE_DIRTY = 4;      // leaf only
+    static constexpr unsigned PTE_SHIFT = 3;      // table or frame index above the flags
+    static constexpr size_t TABLE_ENTRIES = (size_t)1 << LEVEL_BITS;
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Frame {
+        uint64_t address = 0;
+        int buddy_id = -1;   // -1 while the slot is free
+        int pid = 0;
+        uint64_t vpn = 0;
+    };
+
+    struct AddressSpace {
+        bool live = false;
+        unsigned page_shift = 0;
+        unsigned levels = 0;
+        uint32_t root = NIL;
+        uint64_t accesses = 0;
+        uint64_t tlb_misses = 0;
+        uint64_t faults = 0;
+        uint64_t resident = 0;
+    };
+
+    BuddyAllocator &buddy;
+    TlbConfig tlb_config;
+    Cache tlb;
+    VmCounters count;
+
+    static constexpr double THRASH_FAULT_RATE = 0.25;
+    size_t max_frames = 0;
+    size_t resident_frames = 0;
+    PageReplacer replacer;
+    WorkingSet working_set;
+    uint64_t window_refs = 0;
+    uint64_t window_faults = 0;
+    size_t peak_working_set = 0;
+    std::vector<WorkingSetSample> timeline;
+
+    std::vector<uint64_t> tables;        // table t is entries [t * 512, (t + 1) * 512)
+    std::vector<uint32_t> free_tables;
+    std::vector<Frame> frames;
+    std::vector<uint32_t> free_frames;
+    std::vector<AddressSpace> spaces;    // indexed by pid; slot 0 unused
+
+    uint32_t newTable();
+    void releaseTables(uint32_t table, unsigned levels_below);
+    uint64_t &leaf(AddressSpace &as, uint64_t vpn);
+    bool allocateFrame(uint64_t page_size, BuddyResult &res);
+    void evict(uint32_t frame);
+};
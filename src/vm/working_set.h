@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+
+// Denning working set W(t, window): the distinct pages among the last
+// `window` references. Each reference is queued once; when it leaves the
+// window it only shrinks the set if it was that page's latest reference,
+// so every update is amortised O(1).
+class WorkingSet {
+public:
+    explicit WorkingSet(uint64_t window = 1024) : window(window ? window : 1) {}
+
+    void reference(uint64_t page) {
+        now++;
+        auto ins = last.emplace(page, now);
+        if (ins.second) current++;
+        else ins.first->second = now;
+        recent.emplace_back(now, page);
+        while (recent.front().first + window <= now) {
+            auto it = last.find(recent.front().second);
+            if (it->second == recent.front().first) {
+                current--;
+                last.erase(it);
+            }
+            recent.pop_front();
+        }
+    }
+
+    size_t size() const { return current; }
+    uint64_t windowSize() const { return window; }
+
+private:
+    uint64_t window;
+    uint64_t now = 0;
+    size_t current = 0;
+    std::unordered_map<uint64_t, uint64_t> last;      // page -> latest reference in the window
+    std::deque<std::pair<uint64_t, uint64_t>> recent; // (time, page), oldest first
+};